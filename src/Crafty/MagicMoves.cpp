@@ -8,6 +8,10 @@
  *The magic keys are not optimal for all squares but they are very close
  *to optimal.
  *
+ *Modified for GinTonic: the move databases are computed by constexpr functions
+ *at compile time instead of by initmagicmoves() at startup. Only the
+ *MINIMIZE_MAGIC configuration is supported in this version.
+ *
  *Copyright (C) 2007 Pradyumna Kannan.
  *
  *This code is provided 'as-is', without any express or implied warranty.
@@ -27,7 +31,7 @@
  *3. This notice may not be removed or altered from any source distribution.
  */
 
-#include "magicmoves.hpp"
+#include "MagicMoves.hpp"
 
 #ifdef _MSC_VER
 	#pragma message("MSC compatible compiler detected -- turning off warning 4312,4146")
@@ -154,79 +158,14 @@ const U64 magicmoves_b_mask[64]=
 	C64(0x0028440200000000), C64(0x0050080402000000), C64(0x0020100804020000), C64(0x0040201008040200)
 };
 
-#ifdef MINIMIZE_MAGIC
-U64 magicmovesbdb[5248];
-const U64* magicmoves_b_indices[64]=
-{
-	magicmovesbdb+4992, magicmovesbdb+2624,  magicmovesbdb+256,  magicmovesbdb+896,
-	magicmovesbdb+1280, magicmovesbdb+1664, magicmovesbdb+4800, magicmovesbdb+5120,
-	magicmovesbdb+2560, magicmovesbdb+2656,  magicmovesbdb+288,  magicmovesbdb+928,
-	magicmovesbdb+1312, magicmovesbdb+1696, magicmovesbdb+4832, magicmovesbdb+4928,
-	magicmovesbdb+0,     magicmovesbdb+128,  magicmovesbdb+320,  magicmovesbdb+960,
-	magicmovesbdb+1344, magicmovesbdb+1728, magicmovesbdb+2304, magicmovesbdb+2432,
-	magicmovesbdb+32,    magicmovesbdb+160,  magicmovesbdb+448, magicmovesbdb+2752,
-	magicmovesbdb+3776, magicmovesbdb+1856, magicmovesbdb+2336, magicmovesbdb+2464,
-	magicmovesbdb+64,    magicmovesbdb+192,  magicmovesbdb+576, magicmovesbdb+3264,
-	magicmovesbdb+4288, magicmovesbdb+1984, magicmovesbdb+2368, magicmovesbdb+2496,
-	magicmovesbdb+96,    magicmovesbdb+224,  magicmovesbdb+704, magicmovesbdb+1088,
-	magicmovesbdb+1472, magicmovesbdb+2112, magicmovesbdb+2400, magicmovesbdb+2528,
-	magicmovesbdb+2592, magicmovesbdb+2688,  magicmovesbdb+832, magicmovesbdb+1216,
-	magicmovesbdb+1600, magicmovesbdb+2240, magicmovesbdb+4864, magicmovesbdb+4960,
-	magicmovesbdb+5056, magicmovesbdb+2720,  magicmovesbdb+864, magicmovesbdb+1248,
-	magicmovesbdb+1632, magicmovesbdb+2272, magicmovesbdb+4896, magicmovesbdb+5184
-};
-#else
-	#ifndef PERFECT_MAGIC_HASH
-		U64 magicmovesbdb[64][1<<9];
-	#else
-		U64 magicmovesbdb[1428];
-		PERFECT_MAGIC_HASH magicmoves_b_indices[64][1<<9];
-	#endif
+#if defined(PERFECT_MAGIC_HASH) || !defined(MINIMIZE_MAGIC)
+	#error magicmoves - compile-time tables are only generated for MINIMIZE_MAGIC
 #endif
 
-#ifdef MINIMIZE_MAGIC
-U64 magicmovesrdb[102400];
-const U64* magicmoves_r_indices[64]=
-{
-	magicmovesrdb+86016, magicmovesrdb+73728, magicmovesrdb+36864, magicmovesrdb+43008,
-	magicmovesrdb+47104, magicmovesrdb+51200, magicmovesrdb+77824, magicmovesrdb+94208,
-	magicmovesrdb+69632, magicmovesrdb+32768, magicmovesrdb+38912, magicmovesrdb+10240,
-	magicmovesrdb+14336, magicmovesrdb+53248, magicmovesrdb+57344, magicmovesrdb+81920,
-	magicmovesrdb+24576, magicmovesrdb+33792,  magicmovesrdb+6144, magicmovesrdb+11264,
-	magicmovesrdb+15360, magicmovesrdb+18432, magicmovesrdb+58368, magicmovesrdb+61440,
-	magicmovesrdb+26624,  magicmovesrdb+4096,  magicmovesrdb+7168,     magicmovesrdb+0,
-	 magicmovesrdb+2048, magicmovesrdb+19456, magicmovesrdb+22528, magicmovesrdb+63488,
-	magicmovesrdb+28672,  magicmovesrdb+5120,  magicmovesrdb+8192,  magicmovesrdb+1024,
-	 magicmovesrdb+3072, magicmovesrdb+20480, magicmovesrdb+23552, magicmovesrdb+65536,
-	magicmovesrdb+30720, magicmovesrdb+34816,  magicmovesrdb+9216, magicmovesrdb+12288,
-	magicmovesrdb+16384, magicmovesrdb+21504, magicmovesrdb+59392, magicmovesrdb+67584,
-	magicmovesrdb+71680, magicmovesrdb+35840, magicmovesrdb+39936, magicmovesrdb+13312,
-	magicmovesrdb+17408, magicmovesrdb+54272, magicmovesrdb+60416, magicmovesrdb+83968,
-	magicmovesrdb+90112, magicmovesrdb+75776, magicmovesrdb+40960, magicmovesrdb+45056,
-	magicmovesrdb+49152, magicmovesrdb+55296, magicmovesrdb+79872, magicmovesrdb+98304
-};
-#else
-	#ifndef PERFECT_MAGIC_HASH
-		U64 magicmovesrdb[64][1<<12];
-	#else
-		U64 magicmovesrdb[4900];
-		PERFECT_MAGIC_HASH magicmoves_r_indices[64][1<<12];
-	#endif
-#endif
-
-U64 initmagicmoves_occ(const int* squares, const int numSquares, const U64 linocc)
-{
-	int i;
-	U64 ret=0;
-	for(i=0;i<numSquares;i++)
-		if(linocc&(((U64)(1))<<i)) ret|=(((U64)(1))<<squares[i]);
-	return ret;
-}
-
-U64 initmagicmoves_Rmoves(const int square, const U64 occ)
+constexpr U64 initmagicmoves_Rmoves(const int square, const U64 occ)
 {
 	U64 ret=0;
-	U64 bit;
+	U64 bit=0;
 	U64 rowbits=(((U64)0xFF)<<(8*(square/8)));
 	
 	bit=(((U64)(1))<<square);
@@ -258,11 +197,11 @@ U64 initmagicmoves_Rmoves(const int square, const U64 occ)
 	return ret;
 }
 
-U64 initmagicmoves_Bmoves(const int square, const U64 occ)
+constexpr U64 initmagicmoves_Bmoves(const int square, const U64 occ)
 {
 	U64 ret=0;
-	U64 bit;
-	U64 bit2;
+	U64 bit=0;
+	U64 bit2=0;
 	U64 rowbits=(((U64)0xFF)<<(8*(square/8)));
 	
 	bit=(((U64)(1))<<square);
@@ -304,165 +243,99 @@ U64 initmagicmoves_Bmoves(const int square, const U64 occ)
 	return ret;
 }
 
-//used so that the original indices can be left as const so that the compiler can optimize better
-
-#ifndef PERFECT_MAGIC_HASH
-	#ifdef MINIMIZE_MAGIC
-		#define BmagicNOMASK2(square, occupancy) *(magicmoves_b_indices2[square]+(((occupancy)*magicmoves_b_magics[square])>>magicmoves_b_shift[square]))
-		#define RmagicNOMASK2(square, occupancy) *(magicmoves_r_indices2[square]+(((occupancy)*magicmoves_r_magics[square])>>magicmoves_r_shift[square]))
-	#else
-		#define BmagicNOMASK2(square, occupancy) magicmovesbdb[square][((occupancy)*magicmoves_b_magics[square])>>MINIMAL_B_BITS_SHIFT(square)]
-		#define RmagicNOMASK2(square, occupancy) magicmovesrdb[square][((occupancy)*magicmoves_r_magics[square])>>MINIMAL_R_BITS_SHIFT(square)]
-	#endif
-/*#else
-	#define BmagicNOMASK2(square, occupancy) magicmovesbdb[magicmoves_b_indices[square][((occupancy)*magicmoves_b_magics[square])>>MINIMAL_B_BITS_SHIFT]]
-	#define RmagicNOMASK2(square, occupancy) magicmovesrdb[magicmoves_r_indices[square][((occupancy)*magicmoves_r_magics[square])>>MINIMAL_R_BITS_SHIFT]]
-*/
-#endif
-
-void initmagicmoves(void)
+//wrapper so that the databases can be returned from constexpr functions
+template <unsigned int N>
+struct initmagicmoves_db
 {
-	int i;
-
-	//for bitscans :
-	//initmagicmoves_bitpos64_database[(x*C64(0x07EDD5E59A4E28C2))>>58]
-	int initmagicmoves_bitpos64_database[64]={
-	63,  0, 58,  1, 59, 47, 53,  2,
-	60, 39, 48, 27, 54, 33, 42,  3,
-	61, 51, 37, 40, 49, 18, 28, 20,
-	55, 30, 34, 11, 43, 14, 22,  4,
-	62, 57, 46, 52, 38, 26, 32, 41,
-	50, 36, 17, 19, 29, 10, 13, 21,
-	56, 45, 25, 31, 35, 16,  9, 12,
-	44, 24, 15,  8, 23,  7,  6,  5};
-
-#ifdef MINIMIZE_MAGIC
-	//identical to magicmove_x_indices except without the const modifer
-	U64* magicmoves_b_indices2[64]=
-	{
-		magicmovesbdb+4992, magicmovesbdb+2624,  magicmovesbdb+256,  magicmovesbdb+896,
-		magicmovesbdb+1280, magicmovesbdb+1664, magicmovesbdb+4800, magicmovesbdb+5120,
-		magicmovesbdb+2560, magicmovesbdb+2656,  magicmovesbdb+288,  magicmovesbdb+928,
-		magicmovesbdb+1312, magicmovesbdb+1696, magicmovesbdb+4832, magicmovesbdb+4928,
-		magicmovesbdb+0,     magicmovesbdb+128,  magicmovesbdb+320,  magicmovesbdb+960,
-		magicmovesbdb+1344, magicmovesbdb+1728, magicmovesbdb+2304, magicmovesbdb+2432,
-		magicmovesbdb+32,    magicmovesbdb+160,  magicmovesbdb+448, magicmovesbdb+2752,
-		magicmovesbdb+3776, magicmovesbdb+1856, magicmovesbdb+2336, magicmovesbdb+2464,
-		magicmovesbdb+64,    magicmovesbdb+192,  magicmovesbdb+576, magicmovesbdb+3264,
-		magicmovesbdb+4288, magicmovesbdb+1984, magicmovesbdb+2368, magicmovesbdb+2496,
-		magicmovesbdb+96,    magicmovesbdb+224,  magicmovesbdb+704, magicmovesbdb+1088,
-		magicmovesbdb+1472, magicmovesbdb+2112, magicmovesbdb+2400, magicmovesbdb+2528,
-		magicmovesbdb+2592, magicmovesbdb+2688,  magicmovesbdb+832, magicmovesbdb+1216,
-		magicmovesbdb+1600, magicmovesbdb+2240, magicmovesbdb+4864, magicmovesbdb+4960,
-		magicmovesbdb+5056, magicmovesbdb+2720,  magicmovesbdb+864, magicmovesbdb+1248,
-		magicmovesbdb+1632, magicmovesbdb+2272, magicmovesbdb+4896, magicmovesbdb+5184
-	};
-	U64* magicmoves_r_indices2[64]=
-	{
-		magicmovesrdb+86016, magicmovesrdb+73728, magicmovesrdb+36864, magicmovesrdb+43008,
-		magicmovesrdb+47104, magicmovesrdb+51200, magicmovesrdb+77824, magicmovesrdb+94208,
-		magicmovesrdb+69632, magicmovesrdb+32768, magicmovesrdb+38912, magicmovesrdb+10240,
-		magicmovesrdb+14336, magicmovesrdb+53248, magicmovesrdb+57344, magicmovesrdb+81920,
-		magicmovesrdb+24576, magicmovesrdb+33792,  magicmovesrdb+6144, magicmovesrdb+11264,
-		magicmovesrdb+15360, magicmovesrdb+18432, magicmovesrdb+58368, magicmovesrdb+61440,
-		magicmovesrdb+26624,  magicmovesrdb+4096,  magicmovesrdb+7168,     magicmovesrdb+0,
-		magicmovesrdb+2048,  magicmovesrdb+19456, magicmovesrdb+22528, magicmovesrdb+63488,
-		magicmovesrdb+28672,  magicmovesrdb+5120,  magicmovesrdb+8192,  magicmovesrdb+1024,
-		magicmovesrdb+3072,  magicmovesrdb+20480, magicmovesrdb+23552, magicmovesrdb+65536,
-		magicmovesrdb+30720, magicmovesrdb+34816,  magicmovesrdb+9216, magicmovesrdb+12288,
-		magicmovesrdb+16384, magicmovesrdb+21504, magicmovesrdb+59392, magicmovesrdb+67584,
-		magicmovesrdb+71680, magicmovesrdb+35840, magicmovesrdb+39936, magicmovesrdb+13312,
-		magicmovesrdb+17408, magicmovesrdb+54272, magicmovesrdb+60416, magicmovesrdb+83968,
-		magicmovesrdb+90112, magicmovesrdb+75776, magicmovesrdb+40960, magicmovesrdb+45056,
-		magicmovesrdb+49152, magicmovesrdb+55296, magicmovesrdb+79872, magicmovesrdb+98304
-	};
-#endif // MINIMIZE_MAGIC
-
-
-#ifdef PERFECT_MAGIC_HASH
-	for(i=0;i<1428;i++)
-		magicmovesbdb[i]=0;
-	for(i=0;i<4900;i++)
-		magicmovesrdb[i]=0;
-#endif
+	U64 moves[N];
+};
 
-	for(i=0;i<64;i++)
-	{
-		int squares[64];
-		int numsquares=0;
-		U64 temp=magicmoves_b_mask[i];
-		while(temp)
-		{
-			U64 bit=temp&-temp;
-			squares[numsquares++]=initmagicmoves_bitpos64_database[(bit*C64(0x07EDD5E59A4E28C2))>>58];
-			temp^=bit;
-		}
-		for(temp=0;temp<(((U64)(1))<<numsquares);temp++)
-		{
-			U64 tempocc=initmagicmoves_occ(squares,numsquares,temp);
-			#ifndef PERFECT_MAGIC_HASH
-				BmagicNOMASK2(i,tempocc)=initmagicmoves_Bmoves(i,tempocc);
-			#else
-				U64 moves=initmagicmoves_Bmoves(i,tempocc);
-				U64 index=(((tempocc)*magicmoves_b_magics[i])>>MINIMAL_B_BITS_SHIFT);
-				int j;
-				for(j=0;j<1428;j++)
-				{
-					if(!magicmovesbdb[j])
-					{
-						magicmovesbdb[j]=moves;
-						magicmoves_b_indices[i][index]=j;
-						break;
-					}
-					else if(magicmovesbdb[j]==moves)
-					{
-						magicmoves_b_indices[i][index]=j;
-						break;
-					}
-				}
-			#endif
-		}
-	}
-	for(i=0;i<64;i++)
+//fills the database for one piece type; offsets[square] is the start of the
+//square's block in the database
+template <unsigned int N>
+constexpr initmagicmoves_db<N> initmagicmoves_generate(const U64* mask, const U64* magics,
+	const unsigned int* shift, const unsigned int* offsets, U64 (*moves)(const int, const U64))
+{
+	initmagicmoves_db<N> db{};
+	for(int i=0;i<64;i++)
 	{
-		int squares[64];
-		int numsquares=0;
-		U64 temp=magicmoves_r_mask[i];
-		while(temp)
-		{
-			U64 bit=temp&-temp;
-			squares[numsquares++]=initmagicmoves_bitpos64_database[(bit*C64(0x07EDD5E59A4E28C2))>>58];
-			temp^=bit;
-		}
-		for(temp=0;temp<(((U64)(1))<<numsquares);temp++)
+		//enumerate all subsets of the mask (carry-rippler) to stay within the
+		//compiler's constexpr evaluation limits
+		U64 tempocc=0;
+		do
 		{
-			U64 tempocc=initmagicmoves_occ(squares,numsquares,temp);
-			#ifndef PERFECT_MAGIC_HASH
-				RmagicNOMASK2(i,tempocc)=initmagicmoves_Rmoves(i,tempocc);
-			#else
-				U64 moves=initmagicmoves_Rmoves(i,tempocc);
-				U64 index=(((tempocc)*magicmoves_r_magics[i])>>MINIMAL_R_BITS_SHIFT);
-				int j;
-				for(j=0;j<4900;j++)
-				{
-					if(!magicmovesrdb[j])
-					{
-						magicmovesrdb[j]=moves;
-						magicmoves_r_indices[i][index]=j;
-						break;
-					}
-					else if(magicmovesrdb[j]==moves)
-					{
-						magicmoves_r_indices[i][index]=j;
-						break;
-					}
-				}
-			#endif
-		}
+			db.moves[offsets[i]+((tempocc*magics[i])>>shift[i])]=moves(i,tempocc);
+			tempocc=(tempocc-mask[i])&mask[i];
+		}while(tempocc);
 	}
+	return db;
 }
 
-void initMagics()
+constexpr unsigned int magicmoves_b_offsets[64]=
+{
+	4992, 2624,  256,  896, 1280, 1664, 4800, 5120,
+	2560, 2656,  288,  928, 1312, 1696, 4832, 4928,
+	   0,  128,  320,  960, 1344, 1728, 2304, 2432,
+	  32,  160,  448, 2752, 3776, 1856, 2336, 2464,
+	  64,  192,  576, 3264, 4288, 1984, 2368, 2496,
+	  96,  224,  704, 1088, 1472, 2112, 2400, 2528,
+	2592, 2688,  832, 1216, 1600, 2240, 4864, 4960,
+	5056, 2720,  864, 1248, 1632, 2272, 4896, 5184
+};
+
+constexpr unsigned int magicmoves_r_offsets[64]=
+{
+	86016, 73728, 36864, 43008, 47104, 51200, 77824, 94208,
+	69632, 32768, 38912, 10240, 14336, 53248, 57344, 81920,
+	24576, 33792,  6144, 11264, 15360, 18432, 58368, 61440,
+	26624,  4096,  7168,     0,  2048, 19456, 22528, 63488,
+	28672,  5120,  8192,  1024,  3072, 20480, 23552, 65536,
+	30720, 34816,  9216, 12288, 16384, 21504, 59392, 67584,
+	71680, 35840, 39936, 13312, 17408, 54272, 60416, 83968,
+	90112, 75776, 40960, 45056, 49152, 55296, 79872, 98304
+};
+
+constexpr initmagicmoves_db<5248> magicmovesbdb=initmagicmoves_generate<5248>(
+	magicmoves_b_mask,magicmoves_b_magics,magicmoves_b_shift,magicmoves_b_offsets,initmagicmoves_Bmoves);
+constexpr initmagicmoves_db<102400> magicmovesrdb=initmagicmoves_generate<102400>(
+	magicmoves_r_mask,magicmoves_r_magics,magicmoves_r_shift,magicmoves_r_offsets,initmagicmoves_Rmoves);
+
+const U64* magicmoves_b_indices[64]=
 {
-    initmagicmoves();
-}
\ No newline at end of file
+	magicmovesbdb.moves+4992, magicmovesbdb.moves+2624,  magicmovesbdb.moves+256,  magicmovesbdb.moves+896,
+	magicmovesbdb.moves+1280, magicmovesbdb.moves+1664, magicmovesbdb.moves+4800, magicmovesbdb.moves+5120,
+	magicmovesbdb.moves+2560, magicmovesbdb.moves+2656,  magicmovesbdb.moves+288,  magicmovesbdb.moves+928,
+	magicmovesbdb.moves+1312, magicmovesbdb.moves+1696, magicmovesbdb.moves+4832, magicmovesbdb.moves+4928,
+	magicmovesbdb.moves+0,     magicmovesbdb.moves+128,  magicmovesbdb.moves+320,  magicmovesbdb.moves+960,
+	magicmovesbdb.moves+1344, magicmovesbdb.moves+1728, magicmovesbdb.moves+2304, magicmovesbdb.moves+2432,
+	magicmovesbdb.moves+32,    magicmovesbdb.moves+160,  magicmovesbdb.moves+448, magicmovesbdb.moves+2752,
+	magicmovesbdb.moves+3776, magicmovesbdb.moves+1856, magicmovesbdb.moves+2336, magicmovesbdb.moves+2464,
+	magicmovesbdb.moves+64,    magicmovesbdb.moves+192,  magicmovesbdb.moves+576, magicmovesbdb.moves+3264,
+	magicmovesbdb.moves+4288, magicmovesbdb.moves+1984, magicmovesbdb.moves+2368, magicmovesbdb.moves+2496,
+	magicmovesbdb.moves+96,    magicmovesbdb.moves+224,  magicmovesbdb.moves+704, magicmovesbdb.moves+1088,
+	magicmovesbdb.moves+1472, magicmovesbdb.moves+2112, magicmovesbdb.moves+2400, magicmovesbdb.moves+2528,
+	magicmovesbdb.moves+2592, magicmovesbdb.moves+2688,  magicmovesbdb.moves+832, magicmovesbdb.moves+1216,
+	magicmovesbdb.moves+1600, magicmovesbdb.moves+2240, magicmovesbdb.moves+4864, magicmovesbdb.moves+4960,
+	magicmovesbdb.moves+5056, magicmovesbdb.moves+2720,  magicmovesbdb.moves+864, magicmovesbdb.moves+1248,
+	magicmovesbdb.moves+1632, magicmovesbdb.moves+2272, magicmovesbdb.moves+4896, magicmovesbdb.moves+5184
+};
+
+const U64* magicmoves_r_indices[64]=
+{
+	magicmovesrdb.moves+86016, magicmovesrdb.moves+73728, magicmovesrdb.moves+36864, magicmovesrdb.moves+43008,
+	magicmovesrdb.moves+47104, magicmovesrdb.moves+51200, magicmovesrdb.moves+77824, magicmovesrdb.moves+94208,
+	magicmovesrdb.moves+69632, magicmovesrdb.moves+32768, magicmovesrdb.moves+38912, magicmovesrdb.moves+10240,
+	magicmovesrdb.moves+14336, magicmovesrdb.moves+53248, magicmovesrdb.moves+57344, magicmovesrdb.moves+81920,
+	magicmovesrdb.moves+24576, magicmovesrdb.moves+33792,  magicmovesrdb.moves+6144, magicmovesrdb.moves+11264,
+	magicmovesrdb.moves+15360, magicmovesrdb.moves+18432, magicmovesrdb.moves+58368, magicmovesrdb.moves+61440,
+	magicmovesrdb.moves+26624,  magicmovesrdb.moves+4096,  magicmovesrdb.moves+7168,     magicmovesrdb.moves+0,
+	 magicmovesrdb.moves+2048, magicmovesrdb.moves+19456, magicmovesrdb.moves+22528, magicmovesrdb.moves+63488,
+	magicmovesrdb.moves+28672,  magicmovesrdb.moves+5120,  magicmovesrdb.moves+8192,  magicmovesrdb.moves+1024,
+	 magicmovesrdb.moves+3072, magicmovesrdb.moves+20480, magicmovesrdb.moves+23552, magicmovesrdb.moves+65536,
+	magicmovesrdb.moves+30720, magicmovesrdb.moves+34816,  magicmovesrdb.moves+9216, magicmovesrdb.moves+12288,
+	magicmovesrdb.moves+16384, magicmovesrdb.moves+21504, magicmovesrdb.moves+59392, magicmovesrdb.moves+67584,
+	magicmovesrdb.moves+71680, magicmovesrdb.moves+35840, magicmovesrdb.moves+39936, magicmovesrdb.moves+13312,
+	magicmovesrdb.moves+17408, magicmovesrdb.moves+54272, magicmovesrdb.moves+60416, magicmovesrdb.moves+83968,
+	magicmovesrdb.moves+90112, magicmovesrdb.moves+75776, magicmovesrdb.moves+40960, magicmovesrdb.moves+45056,
+	magicmovesrdb.moves+49152, magicmovesrdb.moves+55296, magicmovesrdb.moves+79872, magicmovesrdb.moves+98304
+};
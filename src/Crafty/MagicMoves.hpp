@@ -5,9 +5,10 @@
  *need this functionality.
  *
  *Usage:
- *You must first initialize the generator with a call to initmagicmoves().
- *Then you can use the following macros for generating move bitboards by
- *giving them a square and an occupancy.  The macro will then "return"
+ *The move databases are generated at compile time (modified for GinTonic,
+ *see MagicMoves.cpp), so no initialization call is required. You can use
+ *the following macros for generating move bitboards by giving them a
+ *square and an occupancy.  The macro will then "return"
  *the correct move bitboard for that particular square and occupancy. It
  *has been named Rmagic and Bmagic so that it will not conflict with
  *any functions/macros in your chess program called Rmoves/Bmoves. You
@@ -142,10 +143,10 @@ extern const unsigned int magicmoves_r_shift[64];
 			#define RmagicNOMASK(square, occupancy) *(magicmoves_r_indices[square]+(((occupancy)*magicmoves_r_magics[square])>>magicmoves_r_shift[square]))
 		#endif //USE_INLINING
 
-		//extern U64 magicmovesbdb[5248];
+		//magicmovesbdb[5248] is generated at compile time
 		extern const U64* magicmoves_b_indices[64];
 
-		//extern U64 magicmovesrdb[102400];
+		//magicmovesrdb[102400] is generated at compile time
 		extern const U64* magicmoves_r_indices[64];
 
 	#else //Don't Minimize database size
@@ -245,6 +246,4 @@ extern const unsigned int magicmoves_r_shift[64];
 
 #endif //USE_INLINING
 
-void initmagicmoves(void);
-
 #endif //_magicmoveshvesh
@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "adjudicator.hpp"
+#include "chessboard.hpp"
+#include "magic.hpp"
+
+// Games are adjudicated as a draw after this many plies
+#define MAX_GAME_PLIES 400
+// Games are adjudicated as won once the scores of both players stay above this
+// for the same side for a few plies
+#define RESIGN_SCORE 2000
+#define RESIGN_PLIES 6
+// Games are adjudicated as a draw when the score stays close to zero late in the game
+#define DRAW_SCORE 10
+#define DRAW_PLIES 12
+#define DRAW_MIN_PLY 80
+
+using namespace ChessBoardConstants;
+
+void Adjudicator::start(const ChessBoard& board)
+{
+	hashes_.assign(1, board.zobrist_);
+	ply_ = 0;
+	resignCount_ = 0;
+	resignWinner_ = 0;
+	drawCount_ = 0;
+}
+
+bool Adjudicator::isGameOver(const ChessBoard& board, const std::vector<move_t>& movelist, int& result) const
+{
+	if (movelist.empty()) {
+		int sign = (board.player_ == white ? 1 : -1);
+		result = (board.isKingAttacked(board.player_) ? -sign : 0);
+		return true;
+	}
+	
+	size_t reversible = std::min<size_t>(board.drawmoves_, hashes_.size() - 1);
+	if (board.drawmoves_ >= 100 ||
+		std::count(hashes_.end() - 1 - reversible, hashes_.end(), board.zobrist_) >= 3 ||
+		Magic::count(board.occupied_) == 2 ||
+		ply_ >= MAX_GAME_PLIES)
+	{
+		result = 0;
+		return true;
+	}
+	return false;
+}
+
+bool Adjudicator::adjudicate(const ChessBoard& board, score_t score, int& result)
+{
+	// Both players have to agree on the winner, so the plies are counted with
+	// the scores from white's point of view
+	int whiteScore = (board.player_ == white ? score : -score);
+	int winner = (whiteScore >= RESIGN_SCORE ? 1 : whiteScore <= -RESIGN_SCORE ? -1 : 0);
+	resignCount_ = (winner == 0 ? 0 : winner == resignWinner_ ? resignCount_ + 1 : 1);
+	resignWinner_ = winner;
+	drawCount_ = (abs(score) <= DRAW_SCORE ? drawCount_ + 1 : 0);
+	
+	if (resignCount_ >= RESIGN_PLIES) {
+		result = resignWinner_;
+		return true;
+	}
+	if (drawCount_ >= DRAW_PLIES && ply_ >= DRAW_MIN_PLY) {
+		result = 0;
+		return true;
+	}
+	return false;
+}
+
+void Adjudicator::moveMade(const ChessBoard& board)
+{
+	hashes_.push_back(board.zobrist_);
+	++ply_;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+#include "types.hpp"
+
+// Forward declarations
+class ChessBoard;
+
+// Decides when a self-play game is over, either by the rules (checkmate,
+// stalemate, 50-move rule, threefold repetition, bare kings) or by
+// adjudication of the search scores. Results are from white's point of view:
+// 1 win, 0 draw, -1 loss.
+class Adjudicator
+{
+public:
+	void start(const ChessBoard& board);
+	
+	// Checks the position before searching; movelist holds the legal moves
+	bool isGameOver(const ChessBoard& board, const std::vector<move_t>& movelist, int& result) const;
+	
+	// Checks the score of the search for the moving player
+	bool adjudicate(const ChessBoard& board, score_t score, int& result);
+	
+	void moveMade(const ChessBoard& board);
+	int ply() const { return ply_; }
+
+private:
+	std::vector<u64> hashes_;
+	int ply_ = 0;
+	int resignCount_ = 0;
+	int resignWinner_ = 0;	// Side that the last score favoured, from white's point of view
+	int drawCount_ = 0;
+
+};
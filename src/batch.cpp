@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "batch.hpp"
+#include "engine.hpp"
+#include "score.hpp"
+#include "tokens.hpp"
+#include "uci.hpp"
+
+// Search depth of jobs without a limit
+#define DEFAULT_DEPTH 8
+
+using std::string;
+
+namespace
+{
+	struct Job
+	{
+		u64 number;
+		string line;
+	};
+	
+	// Ids are copied into the output; quotes and backslashes would break the JSON
+	string jsonString(const string& s)
+	{
+		string result = "\"";
+		for (char c : s) {
+			if (c == '"' || c == '\\') result.push_back('\\');
+			result.push_back(c);
+		}
+		return result + "\"";
+	}
+	
+	string analyse(Engine& engine, const Job& job)
+	{
+		Tokens tokens(job.line);
+		string id = std::to_string(job.number);
+		SearchLimits limits;
+		while (!tokens.empty()) {
+			Tokens next = tokens;
+			std::string_view key = next.next();
+			if (key == "fen" || key == "startpos") break;
+			tokens = next;
+			if (tokens.empty()) break;
+			std::string_view value = tokens.next();
+			if (key == "id") id = string(value);
+			else if (key == "depth") limits.depth = std::max(1, Tokens::toInt(value));
+			else if (key == "nodes") limits.nodes = Tokens::toU64(value);
+			else if (key == "movetime") limits.movetime = std::max(1, Tokens::toInt(value));
+		}
+		if (!limits.depth && !limits.nodes && !limits.movetime) limits.depth = DEFAULT_DEPTH;
+		
+		std::stringstream ss;
+		ss << "{\"id\":" << jsonString(id);
+		ChessBoard& board = engine.board();
+		if (tokens.empty() || !board.setPosition(tokens.rest())) {
+			ss << ",\"error\":\"invalid position\"}";
+			return ss.str();
+		}
+		
+		engine.Search(limits);
+		move_t move = engine.bestMove();
+		score_t value = engine.bestValue();
+		const std::vector<Engine::Iteration>& iterations = engine.iterations();
+		
+		ss << ",\"bestmove\":" << (move ? jsonString(board.uciMove(move)) : "null");
+		if (abs(value) < Score::mate_bound) {
+			ss << ",\"cp\":" << value;
+		} else {
+			ss << ",\"mate\":" << ((Score::checkmate - abs(value) + 1) / 2) * (value > 0 ? 1 : -1);
+		}
+		ss << ",\"depth\":" << (iterations.empty() ? 0 : iterations.back().depth);
+		ss << ",\"nodes\":" << engine.nodesSearched();
+		ss << ",\"time_ms\":" << (iterations.empty() ? 0 : iterations.back().time) << "}";
+		return ss.str();
+	}
+}
+
+void BatchAnalysis::run(const Settings& settings, std::istream& in)
+{
+	auto hashtable = std::make_shared<TranspositionTable>((size_t) settings.hashSize * 1024 * 1024);
+	
+	std::mutex queueMutex;
+	std::condition_variable queueChanged;
+	std::deque<Job> queue;
+	bool inputDone = false;
+	
+	auto worker = [&]() {
+		Engine engine(hashtable);
+		engine.setQuiet(true);
+		for (auto& option : settings.options) engine.setOption(option.first, option.second);
+		
+		while (true) {
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				queueChanged.wait(lock, [&]() { return !queue.empty() || inputDone; });
+				if (queue.empty()) return;
+				job = std::move(queue.front());
+				queue.pop_front();
+			}
+			UCIProtocol::sendMessage(analyse(engine, job));
+		}
+	};
+	
+	std::vector<std::thread> threads;
+	for (int i = 0; i < settings.threads; ++i) threads.emplace_back(worker);
+	
+	// Jobs are numbered by their input line, which is the id if none is given
+	u64 number = 0;
+	for (string line; std::getline(in, line);) {
+		++number;
+		if (line.find_first_not_of(" \t\r") == string::npos) continue;
+		std::lock_guard<std::mutex> lock(queueMutex);
+		queue.push_back({ number, line });
+		queueChanged.notify_one();
+	}
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		inputDone = true;
+	}
+	queueChanged.notify_all();
+	for (std::thread& thread : threads) thread.join();
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Analyses a stream of positions with a pool of engines
+//
+// Every input line is a job:
+//   [id <id>] [depth <d>] [nodes <n>] [movetime <ms>] (fen <fen> | startpos) [moves <m1> ...]
+// Results are written as one JSON object per line in the order in which the
+// jobs finish. All engines share one hash table.
+class BatchAnalysis
+{
+public:
+	struct Settings {
+		int threads = 1;
+		int hashSize = 64;		// in megabytes, shared by all threads
+		std::vector<std::pair<std::string, std::string>> options;	// applied to every engine
+	};
+	
+	static void run(const Settings& settings, std::istream& in);
+
+private:
+	BatchAnalysis() = delete;
+
+};
@@ -0,0 +1,280 @@
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "bench.hpp"
+#include "engine.hpp"
+#include "tokens.hpp"
+#include "uci.hpp"
+
+// Command lines of the protocol benchmark
+#define PROTOCOL_LINES 1000000
+
+// Least number of records parsed by the FEN benchmark
+#define FEN_RECORDS 1000000
+
+using std::string;
+using namespace std::chrono;
+
+const std::vector<string> Benchmark::positions = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"rnbqkb1r/pppppppp/5n2/8/3P4/8/PPP1PPPP/RNBQKBNR w KQkq - 1 2",
+	"r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+	"rnbqkb1r/pp1p1ppp/4pn2/2p5/2PP4/2N5/PP2PPPP/R1BQKBNR w KQkq - 0 4",
+	"r1bqk2r/pppp1ppp/2n2n2/2b1p3/2B1P3/3P1N2/PPP2PPP/RNBQK2R w KQkq - 1 5",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+	"4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+	"rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14 moves d4e6",
+	"r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14 moves g2g4",
+	"r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+	"r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+	"r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+	"4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+	"2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+	"r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+	"3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+	"r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+	"4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+	"3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+	"6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+	"3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+	"2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1 moves g5g6 f3e3 g6g5 e3f3",
+	"8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+	"7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+	"8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+	"8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+	"8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+	"8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+	"5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+	"6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+	"1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+	"6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+	"8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+	"5rk1/q6p/2p3bR/1pPp1rP1/1P1Pp3/P3B1Q1/1K3P2/R7 w - - 93 90",
+	"4rrk1/1p1nq3/p7/2p1P1pp/3P2bp/3Q1Bn1/PPPB4/1K2R1NR w - - 40 21",
+	"r3k2r/3nnpbp/q2pp1p1/p7/Pp1PPPP1/4BNN1/1P5P/R2Q1RK1 w kq - 0 16",
+	"3Qb1k1/1r2ppb1/pN1n2q1/Pp1Pp1Pr/4P2p/4BP2/4B1R1/1R5K b - - 11 40",
+	"4k3/3q1r2/1N2r1b1/3ppN2/2nPP3/1B1R2n1/2R1Q3/3K4 w - - 5 1",
+	"8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+	"8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+	"8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+	"8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+	"8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1",
+	"8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
+	"8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+	"6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+	"r2r1n2/pp2bk2/2p1p2p/3q4/3PN1QP/2P3R1/P4PP1/5RK1 w - - 0 1",
+	"2r2b2/5p2/5k2/p1r1pP2/P2pB3/1P3P2/K1P3R1/7R w - - 23 93",
+	"1r6/1P4bk/3qr1p1/N6p/3pp2P/6R1/3Q1PP1/1R4K1 w - - 1 42",
+};
+
+void Benchmark::run(const Settings& settings)
+{
+	std::vector<u64> nodes(positions.size(), 0);
+	std::atomic<size_t> next(0);
+	std::atomic<bool> failed(false);
+	std::mutex statsMutex;
+	SearchStats stats;
+	
+	auto startTime = steady_clock::now();
+	
+	// Every position is searched with a cleared hash table, so the node count
+	// of a position does not depend on which thread searched it or in which order
+	auto worker = [&]() {
+		Engine engine(settings.hashSize, true);
+		// Options were validated when they were set on the main engine
+		for (auto& option : settings.options) engine.setOption(option.first, option.second);
+		
+		SearchLimits limits;
+		limits.depth = settings.depth;
+		SearchStats threadStats;
+		
+		for (size_t i = next++; i < positions.size(); i = next++) {
+			if (!engine.board().setPosition(positions[i])) {
+				failed = true;
+				continue;
+			}
+			engine.newGame();
+			engine.Search(limits);
+			nodes[i] = engine.nodesSearched();
+			threadStats += engine.stats();
+		}
+		std::lock_guard<std::mutex> lock(statsMutex);
+		stats += threadStats;
+	};
+	
+	std::vector<std::thread> threads;
+	for (int i = 1; i < settings.threads; ++i) threads.emplace_back(worker);
+	worker();
+	for (std::thread& thread : threads) thread.join();
+	
+	auto milli = duration_cast<milliseconds>(steady_clock::now() - startTime).count();
+	u64 totalNodes = 0;
+	for (u64 n : nodes) totalNodes += n;
+	u64 nps = totalNodes * 1000 / std::max<long long>(1, milli);
+	
+	if (failed) UCIProtocol::sendMessage("info string error: invalid benchmark position");
+	
+	std::stringstream ss;
+	if (settings.json) {
+		ss << "{\"depth\":" << settings.depth << ",\"hash\":" << settings.hashSize;
+		ss << ",\"threads\":" << settings.threads << ",\"positions\":" << positions.size();
+		ss << ",\"nodes\":" << totalNodes << ",\"time_ms\":" << milli << ",\"nps\":" << nps;
+		ss << ",\"qnodes\":" << stats.qnodes;
+		ss << ",\"full_evals\":" << stats.fullEvaluations << ",\"lazy_evals\":" << stats.lazyEvaluations;
+		ss << ",\"eval_cache_hits\":" << stats.evalCacheHits << ",\"tb_hits\":" << stats.tbHits;
+		ss << ",\"tt_probes\":" << stats.ttProbes << ",\"tt_hits\":" << stats.ttHits;
+		ss << ",\"tt_collisions\":" << stats.ttCollisions << ",\"tt_cutoffs\":" << stats.ttCutoffs;
+		ss << ",\"tt_stores\":" << stats.ttStores << ",\"cutoffs\":[";
+		for (int i = 0; i < SearchStats::cutoffBuckets; ++i) ss << (i ? "," : "") << stats.cutoffs[i];
+		ss << "],\"delta_pruned\":" << stats.deltaPruned;
+		ss << ",\"position_nodes\":[";
+		for (size_t i = 0; i < nodes.size(); ++i) ss << (i ? "," : "") << nodes[i];
+		ss << "]}";
+	} else {
+		for (size_t i = 0; i < nodes.size(); ++i) {
+			ss << "Position " << (i + 1) << "/" << positions.size() << ": " << nodes[i] << " nodes\n";
+		}
+		ss << "===========================\n";
+		ss << "Total time (ms) : " << milli << "\n";
+		ss << "Nodes searched  : " << totalNodes << "\n";
+		ss << "Qsearch nodes   : " << stats.qnodes << "\n";
+		ss << "Full evaluations: " << stats.fullEvaluations << "\n";
+		ss << "Lazy evaluations: " << stats.lazyEvaluations << "\n";
+		ss << "Eval cache hits : " << stats.evalCacheHits << "\n";
+		ss << "Tablebase hits  : " << stats.tbHits << "\n";
+		ss << "TT hits         : " << stats.ttHits << "/" << stats.ttProbes << "\n";
+		ss << "First move cuts : " << stats.cutoffs[0] << "\n";
+		ss << "Nodes/second    : " << nps;
+	}
+	UCIProtocol::sendMessage(ss.str());
+}
+
+namespace
+{
+	// A game as a GUI sends it: Every move is a new position command with all moves
+	const char* protocolGame[] = {
+		"e2e4", "c7c5", "g1f3", "d7d6", "d2d4", "c5d4", "f3d4", "g8f6", "b1c3", "a7a6",
+		"c1e3", "e7e5", "d4b3", "c8e6", "f2f3", "f8e7", "d1d2", "e8g8", "e1c1", "b8d7",
+		"g2g4", "b7b5", "g4g5", "b5b4", "c3e2", "f6e8", "f3f4", "a6a5", "f4f5", "a5a4",
+		"b3d4", "e5d4", "e2d4", "b4b3", "c1b1", "b3c2", "d4c2", "e6b3", "a2b3", "a4b3"
+	};
+	
+	std::vector<string> protocolStream(u64 lines)
+	{
+		const size_t plies = sizeof(protocolGame) / sizeof(protocolGame[0]);
+		std::vector<string> stream;
+		string moves;
+		for (size_t ply = 0; stream.size() < lines; ply = (ply + 1) % plies) {
+			if (ply == 0) {
+				stream.push_back("ucinewgame");
+				stream.push_back("setoption name Hash value 128");
+				stream.push_back("isready");
+				moves = "position startpos moves";
+			}
+			moves += " ";
+			moves += protocolGame[ply];
+			stream.push_back(moves);
+			stream.push_back("go wtime 300000 btime 300000 winc 2000 binc 2000");
+			if (ply % 8 == 7) stream.push_back("stop");
+		}
+		stream.resize(lines);
+		return stream;
+	}
+}
+
+void Benchmark::runProtocol(u64 lines, bool json)
+{
+	if (!lines) lines = PROTOCOL_LINES;
+	std::vector<string> stream = protocolStream(lines);
+	
+	// Every token is visited like the handler of its command would do
+	auto startTime = steady_clock::now();
+	u64 tokens = 0, commands = 0;
+	for (const string& line : stream) {
+		Tokens lineTokens(line);
+		while (!lineTokens.empty()) {
+			if (UCIProtocol::findCommand(lineTokens.next()) != UCIProtocol::none) break;
+		}
+		++commands;
+		for (; !lineTokens.empty(); lineTokens.next()) ++tokens;
+	}
+	auto parseNanos = duration_cast<nanoseconds>(steady_clock::now() - startTime).count();
+	
+	// Search output, a bestmove after every few info lines
+	const string info = "info depth 12 seldepth 18 multipv 1 nodes 1234567 nps 1345678 tbhits 0 "
+		"score cp 31 pv e2e4 e7e5 g1f3 b8c6 f1b5 a7a6 b5a4 g8f6";
+	std::ofstream null("/dev/null");
+	long long outputNanos[2];
+	for (int flushed = 0; flushed < 2; ++flushed) {
+		OutputWriter writer(null);
+		startTime = steady_clock::now();
+		for (u64 i = 1; i <= lines; ++i) {
+			writer.write(i % 20 ? info : "bestmove e2e4 ponder e7e5");
+			if (flushed) writer.flush();
+		}
+		writer.flush();
+		outputNanos[flushed] = duration_cast<nanoseconds>(steady_clock::now() - startTime).count();
+	}
+	
+	std::stringstream ss;
+	if (json) {
+		ss << "{\"lines\":" << lines << ",\"tokens\":" << tokens;
+		ss << ",\"parse_ns\":" << parseNanos << ",\"output_buffered_ns\":" << outputNanos[0];
+		ss << ",\"output_flushed_ns\":" << outputNanos[1] << "}";
+	} else {
+		ss << "Command lines        : " << commands << "\n";
+		ss << "Tokens               : " << tokens << "\n";
+		ss << "Parsing (ns/line)    : " << (double)parseNanos / lines << "\n";
+		ss << "Output, buffered     : " << (double)outputNanos[0] / lines << " ns/line\n";
+		ss << "Output, line flushes : " << (double)outputNanos[1] / lines << " ns/line";
+	}
+	UCIProtocol::sendMessage(ss.str());
+}
+
+void Benchmark::runFEN(const string& file, bool json)
+{
+	std::vector<string> records;
+	if (file.empty()) {
+		records = positions;
+	} else {
+		std::ifstream in(file);
+		for (string line; std::getline(in, line);) {
+			if (line.find_first_not_of(" \t\r") != string::npos) records.push_back(line);
+		}
+		if (records.empty()) {
+			UCIProtocol::sendMessage("info string error: no positions in " + file);
+			return;
+		}
+	}
+	
+	ChessBoard board;
+	u64 parsed = 0, invalid = 0, checksum = 0;
+	auto startTime = steady_clock::now();
+	while (parsed < FEN_RECORDS) {
+		for (const string& record : records) {
+			if (!board.setFEN(record)) ++invalid;
+			checksum += board.zobrist_;
+		}
+		parsed += records.size();
+	}
+	auto nanos = duration_cast<nanoseconds>(steady_clock::now() - startTime).count();
+	u64 perSecond = parsed * 1000000000 / std::max<long long>(1, nanos);
+	
+	std::stringstream ss;
+	if (json) {
+		ss << "{\"records\":" << records.size() << ",\"parsed\":" << parsed << ",\"invalid\":" << invalid;
+		ss << ",\"time_ns\":" << nanos << ",\"fens_per_second\":" << perSecond << ",\"checksum\":" << checksum << "}";
+	} else {
+		ss << "Records         : " << records.size() << "\n";
+		ss << "Parsed          : " << parsed << " (" << invalid << " invalid)\n";
+		ss << "Parsing (ns/FEN): " << (double)nanos / parsed << "\n";
+		ss << "FENs/second     : " << perSecond << "\n";
+		ss << "Checksum        : " << checksum;
+	}
+	UCIProtocol::sendMessage(ss.str());
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "types.hpp"
+
+class Benchmark
+{
+public:
+	struct Settings {
+		int depth = 5;
+		int hashSize = 16;	// in megabytes, per thread
+		int threads = 1;
+		bool json = false;
+		std::vector<std::pair<std::string, std::string>> options;	// applied to every engine
+	};
+	
+	// Searches all built-in positions to a fixed depth and reports the total node
+	// count (a deterministic signature of the search) together with the speed.
+	static void run(const Settings& settings);
+	
+	// Splits and dispatches a synthetic stream of GUI commands without executing
+	// them and writes search output through the protocol buffer, once flushed
+	// at the sync points and once after every line (lines = 0 for the default)
+	static void runProtocol(u64 lines, bool json);
+	
+	// Parses the FEN records of a file (one per line, the built-in positions
+	// without a file) repeatedly until at least a million were read
+	static void runFEN(const std::string& file, bool json);
+	
+	static const std::vector<std::string> positions;
+
+private:
+	Benchmark() = delete;
+
+};
@@ -0,0 +1,375 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "bitbases.hpp"
+#include "chessboard.hpp"
+#include "magic.hpp"
+#include "uci.hpp"
+
+// File header: magic, version, endgame and number of positions
+#define BITBASE_MAGIC "GTBB"
+#define BITBASE_VERSION 1
+// Positions per work item of a generation pass
+#define CHUNK_SIZE 4096
+
+using std::string;
+using namespace ChessBoardConstants;
+using namespace std::chrono;
+
+namespace
+{
+	const char* names[] = { "KQK", "KRK", "KBNK", "KPK" };
+	
+	// Pieces of the strong side besides its king
+	const std::vector<piece_t> strongPieces[] = { { queen }, { rook }, { bishop, knight }, { pawn } };
+	
+	// Without pawns the strong king is mirrored into the a1-d1-d4 triangle
+	const square_t triangle[10] = { 0, 1, 2, 3, 9, 10, 11, 18, 19, 27 };
+	const int triangleIndex[64] = {
+		 0,  1,  2,  3, -1, -1, -1, -1,
+		-1,  4,  5,  6, -1, -1, -1, -1,
+		-1, -1,  7,  8, -1, -1, -1, -1,
+		-1, -1, -1,  9, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1
+	};
+	
+	enum State : u8 { unknown, win, draw, invalid };
+	
+	int pieceCount(Bitbases::Endgame endgame)
+	{
+		return 2 + (int) strongPieces[endgame].size();
+	}
+	
+	// Side to move (0 = strong side), then the squares of the strong king,
+	// the weak king and the other pieces. With pawns only the files are
+	// mirrored, so that the pawn stands on files a-d.
+	u64 positions(Bitbases::Endgame endgame)
+	{
+		if (endgame == Bitbases::KPK) return 2 * 32 * 64 * 64;
+		u64 count = 2 * 10;
+		for (int i = 1; i < pieceCount(endgame); ++i) count *= 64;
+		return count;
+	}
+	
+	// Mirrors the squares into the stored range and returns the index
+	u64 index(Bitbases::Endgame endgame, int stm, square_t* squares)
+	{
+		int count = pieceCount(endgame);
+		if (endgame == Bitbases::KPK) {
+			if ((squares[2] & 7) > 3) {
+				for (int i = 0; i < count; ++i) squares[i] ^= 7;
+			}
+			return ((u64) (stm * 32 + (squares[2] >> 3) * 4 + (squares[2] & 7)) * 64 + squares[0]) * 64 + squares[1];
+		}
+		
+		if ((squares[0] & 7) > 3) {
+			for (int i = 0; i < count; ++i) squares[i] ^= 7;
+		}
+		if ((squares[0] >> 3) > 3) {
+			for (int i = 0; i < count; ++i) squares[i] ^= 56;
+		}
+		if ((squares[0] >> 3) > (squares[0] & 7)) {
+			for (int i = 0; i < count; ++i) squares[i] = ((squares[i] >> 3) | (squares[i] << 3)) & 63;
+		}
+		u64 idx = stm * 10 + triangleIndex[squares[0]];
+		for (int i = 1; i < count; ++i) idx = idx * 64 + squares[i];
+		return idx;
+	}
+	
+	void decode(Bitbases::Endgame endgame, u64 idx, int& stm, square_t* squares)
+	{
+		if (endgame == Bitbases::KPK) {
+			squares[1] = idx % 64;
+			squares[0] = (idx / 64) % 64;
+			int pawn = (idx / 4096) % 32;
+			squares[2] = (pawn / 4) * 8 + pawn % 4;
+			stm = (int) (idx / (32 * 4096));
+			return;
+		}
+		for (int i = pieceCount(endgame) - 1; i > 0; --i) {
+			squares[i] = idx % 64;
+			idx /= 64;
+		}
+		squares[0] = triangle[idx % 10];
+		stm = (int) (idx / 10);
+	}
+	
+	// Finds the endgame of a position with the strong side as white
+	bool locate(const ChessBoard& board, Bitbases::Endgame& endgame, u64& idx, bool& strongToMove)
+	{
+		int count = Magic::count(board.occupied_);
+		if (count < 3 || count > 4) return false;
+		player_t strong = (Magic::count(board.mask_[white]) > 1 ? white : black);
+		if (Magic::count(board.mask_[strong ^ opponent]) != 1) return false;
+		
+		if (count == 4) {
+			if (!board.mask_[strong | bishop] || !board.mask_[strong | knight]) return false;
+			endgame = Bitbases::KBNK;
+		} else if (board.mask_[strong | queen]) {
+			endgame = Bitbases::KQK;
+		} else if (board.mask_[strong | rook]) {
+			endgame = Bitbases::KRK;
+		} else if (board.mask_[strong | pawn]) {
+			endgame = Bitbases::KPK;
+		} else {
+			return false;
+		}
+		
+		square_t flip = (strong == black ? mirror_square : 0);
+		square_t squares[4];
+		squares[0] = Magic::firstBit(board.mask_[strong | king]) ^ flip;
+		squares[1] = Magic::firstBit(board.mask_[(strong ^ opponent) | king]) ^ flip;
+		for (size_t i = 0; i < strongPieces[endgame].size(); ++i) {
+			squares[2 + i] = Magic::firstBit(board.mask_[strong | strongPieces[endgame][i]]) ^ flip;
+		}
+		strongToMove = (board.player_ == strong);
+		idx = index(endgame, strongToMove ? 0 : 1, squares);
+		return true;
+	}
+	
+	// Retrograde analysis by repeated passes over the unresolved positions:
+	// White wins if one move reaches a win, or if black to move has only
+	// moves into wins. Positions that are still unresolved at the end are
+	// draws. Results of other endgames (promotions) are taken from the
+	// bitbases generated before; captures leave insufficient material.
+	class Generator
+	{
+	public:
+		Generator(Bitbases::Endgame endgame, const Bitbases& finished)
+			:endgame_(endgame), finished_(finished), states_(positions(endgame))
+		{
+		}
+		
+		int passes() const { return passes_; }
+		
+		void run(int threads)
+		{
+			parallel(threads, [this](ChessBoard& board, std::vector<move_t>&, u64 idx) { return initialize(board, idx); });
+			while (parallel(threads, [this](ChessBoard& board, std::vector<move_t>& movelist, u64 idx) { return resolve(board, movelist, idx); }) > 0) {
+				++passes_;
+			}
+		}
+		
+		std::vector<u64> bits() const
+		{
+			std::vector<u64> result((states_.size() + 63) / 64, 0);
+			for (size_t i = 0; i < states_.size(); ++i) {
+				if (states_[i].load(std::memory_order_relaxed) == win) result[i / 64] |= (u64) 1 << (i % 64);
+			}
+			return result;
+		}
+	
+	private:
+		Bitbases::Endgame endgame_;
+		const Bitbases& finished_;
+		std::vector<std::atomic<u8>> states_;
+		int passes_ = 0;
+		
+		// Runs a pass over all positions and returns the number of changed states.
+		// Results of a pass are used as soon as they are known.
+		template <typename F>
+		u64 parallel(int threads, F function)
+		{
+			std::atomic<u64> next(0);
+			std::atomic<u64> changed(0);
+			auto worker = [&]() {
+				ChessBoard board;
+				std::vector<move_t> movelist;
+				u64 localChanged = 0;
+				for (u64 chunk = next++; chunk * CHUNK_SIZE < states_.size(); chunk = next++) {
+					u64 end = std::min<u64>((chunk + 1) * CHUNK_SIZE, states_.size());
+					for (u64 idx = chunk * CHUNK_SIZE; idx < end; ++idx) {
+						if (states_[idx].load(std::memory_order_relaxed) != unknown) continue;
+						State state = function(board, movelist, idx);
+						if (state != unknown) {
+							states_[idx].store(state, std::memory_order_relaxed);
+							++localChanged;
+						}
+					}
+				}
+				changed += localChanged;
+			};
+			std::vector<std::thread> workers;
+			for (int i = 1; i < threads; ++i) workers.emplace_back(worker);
+			worker();
+			for (std::thread& thread : workers) thread.join();
+			return changed;
+		}
+		
+		bool setup(ChessBoard& board, u64 idx)
+		{
+			int stm;
+			square_t squares[4];
+			piece_t pieces[4] = { white | king, black | king };
+			decode(endgame_, idx, stm, squares);
+			
+			int count = pieceCount(endgame_);
+			for (int i = 0; i < count; ++i) {
+				for (int j = 0; j < i; ++j) {
+					if (squares[i] == squares[j]) return false;
+				}
+			}
+			for (size_t i = 0; i < strongPieces[endgame_].size(); ++i) pieces[2 + i] = white | strongPieces[endgame_][i];
+			if (endgame_ == Bitbases::KPK && (squares[2] < 8 || squares[2] >= 56)) return false;
+			
+			board.setPieces(squares, pieces, count, stm == 0 ? white : black);
+			return true;
+		}
+		
+		State initialize(ChessBoard& board, u64 idx)
+		{
+			// The side that is not to move must not be in check
+			if (!setup(board, idx) || board.isKingAttacked(board.player_ ^ opponent)) return invalid;
+			return unknown;
+		}
+		
+		// State of the position after a move
+		State successor(const ChessBoard& board) const
+		{
+			Bitbases::Endgame endgame;
+			u64 idx;
+			bool strongToMove;
+			if (!locate(board, endgame, idx, strongToMove)) return draw;
+			if (endgame == endgame_) return (State) states_[idx].load(std::memory_order_relaxed);
+			
+			int result;
+			if (!finished_.probe(board, result)) return draw;
+			bool whiteWins = (board.player_ == white ? result > 0 : result < 0);
+			return whiteWins ? win : draw;
+		}
+		
+		State resolve(ChessBoard& board, std::vector<move_t>& movelist, u64 idx)
+		{
+			setup(board, idx);
+			movelist.clear();
+			board.generateMoves(movelist);
+			bool whiteToMove = (board.player_ == white);
+			if (movelist.empty()) return (!whiteToMove && board.isKingAttacked(black)) ? win : draw;
+			
+			bool unresolved = false;
+			for (move_t move : movelist) {
+				board.doMove(move);
+				State state = successor(board);
+				board.undoMove(move);
+				if (whiteToMove && state == win) return win;
+				if (!whiteToMove && state == draw) return draw;
+				if (state == unknown) unresolved = true;
+			}
+			if (unresolved) return unknown;
+			return whiteToMove ? draw : win;
+		}
+	};
+	
+	string fileName(const string& directory, Bitbases::Endgame endgame)
+	{
+		return directory + "/" + names[endgame] + ".bitbase";
+	}
+}
+
+void Bitbases::run(const Settings& settings)
+{
+	bool selected[endgames] = {};
+	std::stringstream list(settings.endgames);
+	string name;
+	while (std::getline(list, name, ',')) {
+		for (int e = 0; e < endgames; ++e) {
+			if (name == names[e]) selected[e] = true;
+		}
+	}
+	if (selected[KPK]) selected[KQK] = selected[KRK] = true;
+	if (std::find(selected, selected + endgames, true) == selected + endgames) {
+		UCIProtocol::sendMessage("info string error: no endgame in " + settings.endgames);
+		return;
+	}
+	
+	Bitbases bitbases;
+	for (int e = 0; e < endgames; ++e) {
+		if (!selected[e]) continue;
+		Endgame endgame = (Endgame) e;
+		auto startTime = steady_clock::now();
+		Generator generator(endgame, bitbases);
+		generator.run(settings.threads);
+		bitbases.bits_[endgame] = generator.bits();
+		auto milli = duration_cast<milliseconds>(steady_clock::now() - startTime).count();
+		
+		u64 wins = 0;
+		for (u64 word : bitbases.bits_[endgame]) wins += Magic::count(word);
+		
+		string file = fileName(settings.output, endgame);
+		std::ofstream out(file, std::ios::binary);
+		u32 header[2] = { BITBASE_VERSION, (u32) endgame };
+		u64 count = positions(endgame);
+		out.write(BITBASE_MAGIC, 4);
+		out.write(reinterpret_cast<const char*>(header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+		out.write(reinterpret_cast<const char*>(bitbases.bits_[endgame].data()), bitbases.bits_[endgame].size() * sizeof(u64));
+		if (!out) {
+			UCIProtocol::sendMessage("info string error: writing " + file + " failed");
+			return;
+		}
+		
+		std::stringstream ss;
+		ss << "info string bitbase " << names[endgame] << " positions " << count << " wins " << wins;
+		ss << " passes " << generator.passes() << " time " << milli << " ms";
+		UCIProtocol::sendMessage(ss.str());
+	}
+}
+
+std::shared_ptr<const Bitbases> Bitbases::load(const string& path)
+{
+	static std::mutex cacheMutex;
+	static std::map<string, std::weak_ptr<const Bitbases>> cache;
+	
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	auto cached = cache[path].lock();
+	if (cached) return cached;
+	
+	auto bitbases = std::make_shared<Bitbases>();
+	bool found = false;
+	for (int e = 0; e < endgames; ++e) {
+		Endgame endgame = (Endgame) e;
+		std::ifstream in(fileName(path, endgame), std::ios::binary);
+		if (!in) continue;
+		
+		char magic[4];
+		u32 header[2];
+		u64 count;
+		in.read(magic, 4);
+		in.read(reinterpret_cast<char*>(header), sizeof(header));
+		in.read(reinterpret_cast<char*>(&count), sizeof(count));
+		if (!in || std::memcmp(magic, BITBASE_MAGIC, 4) != 0 || header[0] != BITBASE_VERSION ||
+			header[1] != (u32) endgame || count != positions(endgame))
+		{
+			continue;
+		}
+		std::vector<u64> bits((count + 63) / 64);
+		if (!in.read(reinterpret_cast<char*>(bits.data()), bits.size() * sizeof(u64))) continue;
+		bitbases->bits_[endgame] = std::move(bits);
+		found = true;
+	}
+	if (!found) return nullptr;
+	
+	cache[path] = bitbases;
+	return bitbases;
+}
+
+bool Bitbases::probe(const ChessBoard& board, int& result) const
+{
+	Endgame endgame;
+	u64 idx;
+	bool strongToMove;
+	if (!locate(board, endgame, idx, strongToMove) || bits_[endgame].empty()) return false;
+	bool strongWins = (bits_[endgame][idx / 64] >> (idx % 64)) & 1;
+	result = (strongWins ? (strongToMove ? 1 : -1) : 0);
+	return true;
+}
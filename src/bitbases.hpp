@@ -0,0 +1,44 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "types.hpp"
+
+// Forward declarations
+class ChessBoard;
+
+// Win/draw bitbases of endgames against a lone king, generated by
+// retrograde analysis. Positions are stored with the strong side as white,
+// one bit per position (1 = white wins), reduced by the board symmetries.
+class Bitbases
+{
+public:
+	// In order of generation: Promotions of KPK are looked up in KQK and KRK
+	enum Endgame { KQK, KRK, KBNK, KPK, endgames };
+	
+	struct Settings
+	{
+		int threads = 1;
+		std::string output = ".";	// Directory of the generated files
+		std::string endgames = "KQK,KRK,KBNK,KPK";	// Comma separated
+	};
+	
+	// Generates the bitbases and writes them to <output>/<endgame>.bitbase.
+	// KPK also generates KQK and KRK, which it needs for the promotions.
+	static void run(const Settings& settings);
+	
+	// Loads the bitbases of a directory. Like networks, they are cached by
+	// path and shared between engines. Returns nullptr if no file was found.
+	static std::shared_ptr<const Bitbases> load(const std::string& path);
+	
+	// Result for the moving player (1 win, 0 draw, -1 loss); false if the
+	// position is not covered
+	bool probe(const ChessBoard& board, int& result) const;
+	
+	bool has(Endgame endgame) const { return !bits_[endgame].empty(); }
+
+private:
+	std::vector<u64> bits_[endgames];
+
+};
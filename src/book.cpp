@@ -0,0 +1,119 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "book.hpp"
+#include "chessboard.hpp"
+#include "random.hpp"
+
+// Key (8 bytes), move (2), weight (2), learn (4); all big endian
+#define ENTRY_SIZE 16
+
+using std::string;
+
+namespace
+{
+	u64 readBigEndian(const u8* data, int bytes)
+	{
+		u64 value = 0;
+		for (int i = 0; i < bytes; ++i) value = (value << 8) | data[i];
+		return value;
+	}
+	
+	// Polyglot moves: to file, to rank, from file, from rank (3 bits each) and
+	// the promotion piece. Castles are written as the king capturing its rook.
+	string polyglotMove(u16 move, const ChessBoard& board)
+	{
+		square_t to = (move & 0x3f);
+		square_t from = ((move >> 6) & 0x3f);
+		int promotion = (move >> 12) & 0x7;
+		
+		if ((board.board_[from] & ChessBoardConstants::mask_piecetype) == ChessBoardConstants::king && from % 8 == 4) {
+			if (to == from + 3) to = from + 2;
+			else if (to == from - 4) to = from - 2;
+		}
+		
+		string result = ChessBoard::nameSquare(from) + ChessBoard::nameSquare(to);
+		if (promotion >= 1 && promotion <= 4) result.push_back(" nbrq"[promotion]);
+		return result;
+	}
+}
+
+Book::Book()
+	:random_(Random::Int64())
+{
+}
+
+Book::~Book()
+{
+	close();
+}
+
+bool Book::open(const string& path)
+{
+	close();
+	int file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0) return false;
+	
+	struct stat status;
+	bool valid = (fstat(file, &status) == 0 && status.st_size >= ENTRY_SIZE);
+	void* data = (valid ? mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, file, 0) : MAP_FAILED);
+	::close(file);
+	if (data == MAP_FAILED) return false;
+	
+	// Probes jump around in the file
+	madvise(data, status.st_size, MADV_RANDOM);
+	data_ = static_cast<const u8*>(data);
+	count_ = status.st_size / ENTRY_SIZE;
+	return true;
+}
+
+void Book::close()
+{
+	if (data_) munmap(const_cast<u8*>(data_), count_ * ENTRY_SIZE);
+	data_ = nullptr;
+	count_ = 0;
+}
+
+move_t Book::probe(ChessBoard& board, bool bestMove) const
+{
+	if (!data_) return 0;
+	u64 key = board.polyglotKey();
+	
+	// First entry with a key not less than the position key
+	size_t low = 0, high = count_;
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+		if (readBigEndian(data_ + middle * ENTRY_SIZE, 8) < key) low = middle + 1;
+		else high = middle;
+	}
+	
+	std::vector<move_t> movelist;
+	board.generateMoves(movelist);
+	
+	move_t result = 0;
+	u32 best = 0;
+	u32 totalWeight = 0;
+	for (size_t i = low; i < count_ && readBigEndian(data_ + i * ENTRY_SIZE, 8) == key; ++i) {
+		const u8* entry = data_ + i * ENTRY_SIZE;
+		u32 weight = (u32) readBigEndian(entry + 10, 2);
+		string name = polyglotMove((u16) readBigEndian(entry + 8, 2), board);
+		
+		// Books may contain illegal moves after key collisions
+		move_t move = 0;
+		for (move_t candidate : movelist) {
+			if (board.uciMove(candidate) == name) move = candidate;
+		}
+		if (!move) continue;
+		
+		// Weighted choice in a single pass: Replace with probability weight / total
+		totalWeight += weight;
+		if (bestMove ? (result == 0 || weight > best) : (weight > 0 && std::uniform_int_distribution<u32>(1, totalWeight)(random_) <= weight)) {
+			result = move;
+			best = weight;
+		}
+	}
+	return result;
+}
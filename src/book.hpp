@@ -0,0 +1,37 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include "types.hpp"
+
+// Forward declarations
+class ChessBoard;
+
+// Polyglot opening book
+//
+// The file is memory-mapped and searched in place, so opening a book takes the
+// same time for every size. Entries are sorted by the Polyglot key of the
+// position; all entries of a position are found with a binary search.
+class Book
+{
+public:
+	Book();
+	Book(const Book&) = delete;
+	Book& operator=(const Book&) = delete;
+	~Book();
+	
+	bool open(const std::string& path);
+	void close();
+	bool isOpen() const { return data_ != nullptr; }
+	size_t size() const { return count_; }
+	
+	// Chooses a move randomly, weighted by the entries, or the one with the
+	// highest weight. Returns 0 if the position is not in the book.
+	move_t probe(ChessBoard& board, bool bestMove) const;
+
+private:
+	const u8* data_ = nullptr;
+	size_t count_ = 0;
+	mutable std::mt19937_64 random_;	// Engines searching in parallel each have a book
+
+};
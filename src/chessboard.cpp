@@ -1,12 +1,12 @@
 #include <algorithm>
 #include <cassert>
-#include <sstream>
-#include <boost/algorithm/string/case_conv.hpp>
-#include <boost/regex.hpp>
+#include <charconv>
 
 #include "chessboard.hpp"
 #include "magic.hpp"
+#include "profiler.hpp"
 #include "stdx.hpp"
+#include "tokens.hpp"
 #include "Crafty/MagicMoves.hpp"
 
 using std::string;
@@ -20,6 +20,7 @@ using namespace ChessBoardConstants;
 
 void ChessBoard::generateMoves(std::vector<move_t>& movelist)
 {
+	PROFILE_SCOPE(generateMoves);
 	generateMovesKing(movelist, Data::all_squares);
 	generateMovesKnight(movelist, Data::all_squares);
 	generateMovesSliding(movelist, bishop, Data::all_squares);
@@ -32,6 +33,7 @@ void ChessBoard::generateMoves(std::vector<move_t>& movelist)
 
 void ChessBoard::generateGoodCaptures(std::vector<move_t>& movelist)
 {
+	PROFILE_SCOPE(generateCaptures);
 	player_t color = player_ ^ opponent;
 	bitboard_t capture = mask_[color];
 	generateMovesKing(movelist, capture);
@@ -245,6 +247,7 @@ bool ChessBoard::isKingAttacked(player_t color) const
 
 void ChessBoard::sortMoves(std::vector<move_t>& movelist, move_t sortFirst) const
 {
+	PROFILE_SCOPE(sortMoves);
 	for (size_t i = 0; i < movelist.size(); ++i) {
 		move_t& move = movelist[i];
 		if (move == sortFirst) {
@@ -263,6 +266,8 @@ void ChessBoard::sortMoves(std::vector<move_t>& movelist, move_t sortFirst) cons
 
 void ChessBoard::doMove(move_t move)
 {
+	PROFILE_SCOPE(doMove);
+	
 	// Move format:
 	// 6 bit = from (shift 0)
 	// 6 bit = to (shift 6)
@@ -289,7 +294,7 @@ void ChessBoard::doMove(move_t move)
 	history.enpassant = enpassant_;
 	history.drawmoves = drawmoves_;
 	history.zobrist = zobrist_;
-	history_.push(history);
+	history_.push_back(history);
 	
 	// Update move numbers
 	if (board_[to] != nothing || (board_[from] & mask_piecetype) == pawn) {
@@ -352,13 +357,15 @@ void ChessBoard::doMove(move_t move)
 
 void ChessBoard::undoMove(move_t move)
 {
+	PROFILE_SCOPE(undoMove);
+	
 	// Get move data
 	square_t from = MOVE_FROM(move);
 	square_t to = MOVE_TO(move);
 	u16 special = MOVE_SPECIAL(move);
 	piece_t leave = board_[to];
-	HistoryInfo history = history_.top();
-	history_.pop();
+	HistoryInfo history = history_.back();
+	history_.pop_back();
 	
 	// Switch player
 	player_ ^= opponent;
@@ -400,11 +407,36 @@ void ChessBoard::undoMove(move_t move)
 
 bool ChessBoard::lastMoveWasQuiet() const
 {
-	return history_.empty() || history_.top().capture == nothing;
+	return history_.empty() || history_.back().capture == nothing;
+}
+
+// The position occurred before, since the last capture or pawn move
+bool ChessBoard::isRepetition() const
+{
+	size_t plies = std::min<size_t>(drawmoves_, history_.size());
+	for (size_t ply = 4; ply <= plies; ply += 2) {
+		if (history_[history_.size() - ply].zobrist == zobrist_) return true;
+	}
+	return false;
+}
+
+// Piece that a move captures, including pawns captured en passant
+piece_t ChessBoard::capturedPiece(move_t move) const
+{
+	if (MOVE_SPECIAL(move) == Data::move_enpassant_capture) return (player_ ^ opponent) | pawn;
+	return board_[MOVE_TO(move)];
+}
+
+bool ChessBoard::isPromotion(move_t move) const
+{
+	u16 special = MOVE_SPECIAL(move);
+	return special >= Data::move_promotion_knight && special <= Data::move_promotion_queen;
 }
 
 bool ChessBoard::leavesKingInCheck(move_t move)
 {
+	PROFILE_SCOPE(leavesKingInCheck);
+	
 	// Read data
 	square_t from = MOVE_FROM(move);
 	square_t to = MOVE_TO(move);
@@ -442,6 +474,12 @@ bool ChessBoard::leavesKingInCheck(move_t move)
 	return inCheck;
 }
 
+void ChessBoard::setNetwork(const NNUE::Network* network)
+{
+	network_ = network;
+	accumulator_.dirty[0] = accumulator_.dirty[1] = true;
+}
+
 void ChessBoard::rebuildZobrist()
 {
 	zobrist_ = 0;
@@ -453,69 +491,108 @@ void ChessBoard::rebuildZobrist()
 	if (player_ == black) zobrist_ ^= Data::zobrist[Data::zobrist_player];
 }
 
-bool ChessBoard::setPosition(const tokenizer& tokens, tokenizer::iterator& token)
+u64 ChessBoard::polyglotKey() const
 {
-	if (token == tokens.end()) return false;
+	static const int kinds[8] = { 0, 0, 1, 5, 0, 2, 3, 4 };
+	
+	u64 key = 0;
+	bitboard_t pieces = occupied_;
+	while (pieces) {
+		square_t square = Magic::extractBit(pieces);
+		piece_t piece = board_[square];
+		int kind = 2 * kinds[piece & mask_piecetype] + ((piece & mask_color) == white ? 1 : 0);
+		key ^= Data::polyglot_random[64 * kind + square];
+	}
+	
+	static const u8 castles[4] = {
+		Data::castle_white_kingside, Data::castle_white_queenside,
+		Data::castle_black_kingside, Data::castle_black_queenside
+	};
+	for (int i = 0; i < 4; ++i) {
+		if (castling_ & castles[i]) key ^= Data::polyglot_random[768 + i];
+	}
+	
+	// The en passant file only counts if a pawn stands next to the pawn that moved
+	if (enpassant_) {
+		piece_t capturer = player_ | pawn;
+		if ((enpassant_ % 8 > 0 && board_[enpassant_ - 1] == capturer) ||
+			(enpassant_ % 8 < 7 && board_[enpassant_ + 1] == capturer))
+		{
+			key ^= Data::polyglot_random[772 + enpassant_ % 8];
+		}
+	}
 	
-	if (*token == "fen") {
-		++token;
-		if (token == tokens.end()) return false;
+	if (player_ == white) key ^= Data::polyglot_random[780];
+	return key;
+}
+
+// [fen] <fen> | startpos [moves <move> ...]
+bool ChessBoard::setPosition(std::string_view position)
+{
+	Tokens tokens(position);
+	Tokens next = tokens;
+	std::string_view token = next.next();
+	if (token == "fen") {
+		tokens = next;
+		token = next.next();
 	}
 	
-	if (*token == "startpos") {
+	if (token == "startpos") {
+		tokens = next;
 		setInitialPosition();
-		++token;
-	} else {
-		std::stringstream ss;
-		
-		// Parse FEN: RNBQKBNR/PPPPPPPP/8/8/8/8/pppppppp/rnbqkbnr
-		if (!parseFEN(*token)) return false;
-		++token;
-		
-		// Parse player: w OR b
-		if (token == tokens.end()) return false;
-		if (!parsePlayer(*token)) return false;
-		++token;
-		
-		// Parse castling flags: QKqk OR -
-		if (token == tokens.end()) return false;
-		if (!parseCastling(*token)) return false;
-		++token;
-		
-		// Parse en passant state:
-		if (token == tokens.end()) return false;
-		if (!parseEnpassant(*token)) return false;
-		++token;
-		
-		// Parse move number: 21
-		// Note: We need to read to a temporary int because drawmoves_ is a char
-		if (token == tokens.end()) return false;
-		ss = std::stringstream(*token);
-		int integerDrawmoves;
-		ss >> integerDrawmoves;
-		drawmoves_ = (u8)integerDrawmoves;
-		++token;
-		
-		// Parse draw moves: 7
-		if (token == tokens.end()) return false;
-		ss = std::stringstream(*token);
-		ss >> movenumber_;
-		++token;
-		
-		// Zobrist Hash for this position
-		rebuildZobrist();
+	} else if (!setFEN(tokens)) {
+		return false;
 	}
 	
-	if (token == tokens.end() || *token != "moves") return true;
-	++token;
+	if (tokens.next() != "moves") return true;
+	return playMoves(tokens.rest());
+}
+
+// Reads a FEN or EPD record; move counters are optional and anything after
+// the position fields is ignored
+bool ChessBoard::setFEN(std::string_view fen)
+{
+	Tokens tokens(fen);
+	return setFEN(tokens);
+}
+
+bool ChessBoard::setFEN(Tokens& tokens)
+{
+	if (!parseFEN(tokens.next()) || !parsePlayer(tokens.next()) || !parseCastling(tokens.next()) ||
+		!parseEnpassant(tokens.next()))
+	{
+		return false;
+	}
 	
-	while (token != tokens.end()) {
-		move_t move = parseMove(*token);
-		if (!isValidMove(move)) return false;
-		doMove(move);
-		++token;
+	// A counter is only taken if the whole token is a number
+	int counters[2] = { 0, 1 };
+	for (int& counter : counters) {
+		Tokens next = tokens;
+		std::string_view token = next.next();
+		int value;
+		auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+		if (token.empty() || result.ec != std::errc() || result.ptr != token.data() + token.size()) break;
+		counter = value;
+		tokens = next;
 	}
+	// The 50-move rule is reached at 100 half-moves, larger counters make no difference
+	drawmoves_ = (u8) std::clamp(counters[0], 0, 100);
+	movenumber_ = (u16) std::clamp(counters[1], 1, 0xffff);
 	
+	history_.clear();
+	rebuildZobrist();
+	return true;
+}
+
+// Moves in coordinate notation, separated by spaces
+bool ChessBoard::playMoves(std::string_view moves)
+{
+	Tokens tokens(moves);
+	while (!tokens.empty()) {
+		move_t move = parseMove(tokens.next());
+		if (!move || !isValidMove(move)) return false;
+		doMove(move);
+	}
 	return true;
 }
 
@@ -527,48 +604,73 @@ void ChessBoard::setInitialPosition()
 	enpassant_ = 0;
 	drawmoves_ = 0;
 	movenumber_ = 1;
+	history_.clear();
+	rebuildZobrist();
+}
+
+void ChessBoard::setPieces(const square_t* squares, const piece_t* pieces, int count, player_t player)
+{
+	std::fill_n(mask_, 16, 0L);
+	std::fill_n(board_, 64, 0);
+	accumulator_.dirty[0] = accumulator_.dirty[1] = true;
+	for (int i = 0; i < count; ++i) {
+		mask_[pieces[i]] |= BIT(squares[i]);
+		mask_[pieces[i] & mask_color] |= BIT(squares[i]);
+		board_[squares[i]] = pieces[i];
+	}
+	occupied_ = mask_[white] | mask_[black];
+	player_ = player;
+	castling_ = 0;
+	enpassant_ = 0;
+	drawmoves_ = 0;
+	movenumber_ = 1;
 	rebuildZobrist();
 }
 
 // Fills occupied, whites, blacks and board with data from the FEN-string
-bool ChessBoard::parseFEN(const string& fen)
+bool ChessBoard::parseFEN(std::string_view fen)
 {
 	std::fill_n(mask_, 16, 0L);
 	std::fill_n(board_, 64, 0);
+	accumulator_.dirty[0] = accumulator_.dirty[1] = true;
+	
+	// Characters as pieces, empty squares (16 + n), rank separators (32) or invalid (0)
+	static const struct CharTable {
+		u8 codes[256] = {};
+		CharTable()
+		{
+			const char pieces[] = "PNKBRQ";
+			const piece_t types[] = { pawn, knight, king, bishop, rook, queen };
+			for (int i = 0; i < 6; ++i) {
+				codes[(u8)pieces[i]] = types[i] | white;
+				codes[(u8)(pieces[i] - 'A' + 'a')] = types[i] | black;
+			}
+			for (int n = 1; n <= 8; ++n) codes['0' + n] = 16 + n;
+			codes['/'] = codes['\\'] = 32;
+		}
+	} table;
 	
-	square_t square = 56; // upper left corner
-	piece_t piece = nothing;
+	// Ranks from 8 to 1, each has to fill all 8 files
+	int rank = 7, file = 0;
 	for (char c : fen) {
-		switch (c) {
-			case 'P': piece = pawn | white; break;
-			case 'N': piece = knight | white; break;
-			case 'B': piece = bishop | white; break;
-			case 'R': piece = rook | white; break;
-			case 'Q': piece = queen | white; break;
-			case 'K': piece = king | white; break;
-			case 'p': piece = pawn | black; break;
-			case 'n': piece = knight | black; break;
-			case 'b': piece = bishop | black; break;
-			case 'r': piece = rook | black; break;
-			case 'q': piece = queen | black; break;
-			case 'k': piece = king | black; break;
-			case '/':
-			case '\\':
-				square -= 16;
-				piece = nothing;
-				break;
-			default:
-				if (c < '1' || c > '8') return false;
-				square += (c - '0');
-				piece = nothing;
-				break;
-		}
-		if (piece != nothing) {
-			mask_[piece] |= BIT(square);
-			board_[square] = piece;
-			++square;
+		u8 code = table.codes[(u8)c];
+		if (code && code < 16) {
+			if (file >= 8) return false;
+			square_t square = rank * 8 + file;
+			mask_[code] |= BIT(square);
+			board_[square] = code;
+			++file;
+		} else if (code > 16 && code < 32) {
+			file += code - 16;
+			if (file > 8) return false;
+		} else if (code == 32 && file == 8 && rank > 0) {
+			--rank;
+			file = 0;
+		} else {
+			return false;
 		}
 	}
+	if (rank != 0 || file != 8) return false;
 	for (int i=1; i<8; ++i) {
 		mask_[white] |= mask_[white | i];
 		mask_[black] |= mask_[black | i];
@@ -578,7 +680,7 @@ bool ChessBoard::parseFEN(const string& fen)
 	return true;
 }
 
-bool ChessBoard::parsePlayer(const string& player)
+bool ChessBoard::parsePlayer(std::string_view player)
 {
 	if (player == "w") {
 		player_ = white;
@@ -590,10 +692,11 @@ bool ChessBoard::parsePlayer(const string& player)
 	return true;
 }
 
-bool ChessBoard::parseCastling(const string& castling)
+bool ChessBoard::parseCastling(std::string_view castling)
 {
 	castling_ = 0;
 	if (castling == "-") return true;
+	if (castling.empty()) return false;
 	
 	for (char c : castling) {
 		if (c == 'K') {
@@ -611,23 +714,27 @@ bool ChessBoard::parseCastling(const string& castling)
 	return true;
 }
 
-bool ChessBoard::parseEnpassant(const string& enpassantSquare)
+bool ChessBoard::parseEnpassant(std::string_view enpassantSquare)
 {
 	if (enpassantSquare == "-") {
 		enpassant_ = 0;
 		return true;
 	}
 	if (enpassantSquare.length() != 2) return false;
-	enpassant_ = parseSquare(enpassantSquare);
-	if (enpassant_ >= 64) return false;
+	square_t target = parseSquare(enpassantSquare);
+	if (target >= 64) return false;
+	// FEN names the square behind the pawn, internally the pawn itself is stored
+	if (target / 8 == 2) enpassant_ = target + 8;
+	else if (target / 8 == 5) enpassant_ = target - 8;
+	else return false;
 	return true;
 }
 
-square_t ChessBoard::parseSquare(const string& squareStr)
+// 64 if the name is invalid
+square_t ChessBoard::parseSquare(std::string_view name)
 {
-	assert(squareStr.length() == 2);
-	square_t square = (squareStr[1] - '1') * 8 + (squareStr[0] - 'a');
-	return square;
+	if (name.length() != 2 || name[0] < 'a' || name[0] > 'h' || name[1] < '1' || name[1] > '8') return 64;
+	return (name[1] - '1') * 8 + (name[0] - 'a');
 }
 
 string ChessBoard::nameSquare(square_t square)
@@ -638,34 +745,15 @@ string ChessBoard::nameSquare(square_t square)
 	return result;
 }
 
-// Formats: c7-c8q, e1-e2, f3xg4, e2e4, c7c8q
-move_t ChessBoard::parseMove(std::string move) const
+// Formats: c7-c8q, e1-e2, f3xg4, e2e4, c7c8q, 0-0, 0-0-0 (case insensitive)
+move_t ChessBoard::parseMove(std::string_view move) const
 {
 	static const char promote[5] = "nbrq";
-	static boost::regex format("^[a-h]{1}[1-8]{1}[a-h]{1}[1-8]{1}[qrbn]?$");
 	
 	square_t from, to;
 	u16 special = 0;
 	
-	// Normalize
-	boost::to_lower(move);
-	if (move[2] == '-' || move[2] == 'x') move = move.substr(0, 2) + move.substr(3);
-	
-	// Parse values
-	if (boost::regex_match(move, format)) {
-		from = parseSquare(move.substr(0, 2));
-		to = parseSquare(move.substr(2, 2));
-		if (move.length() == 5) {
-			special = Data::move_promotion_knight + std::distance(promote, std::find(promote, promote+4, move[4]));
-			if (special > Data::move_promotion_queen) return 0;
-		} else if ((board_[from] & mask_piecetype) == pawn) {
-			if (board_[to] == nothing && ((from-to) % 8) != 0) {
-				special = Data::move_enpassant_capture;
-			} else if ((from-to) % 16 == 0) {
-				special = Data::move_double_pawn_push;
-			}
-		}
-	} else if (move == "0-0") {
+	if (move == "0-0") {
 		from = player_ == white ? Data::square_e1 : Data::square_e8;
 		to = player_ == white ? Data::square_g1 : Data::square_g8;
 		special = Data::move_castle_kingside;
@@ -674,7 +762,31 @@ move_t ChessBoard::parseMove(std::string move) const
 		to = player_ == white ? Data::square_c1 : Data::square_c8;
 		special = Data::move_castle_queenside;
 	} else {
-		return 0;
+		// Normalize into a fixed buffer
+		char text[5];
+		size_t length = 0;
+		for (size_t i = 0; i < move.length(); ++i) {
+			char c = move[i];
+			if (i == 2 && (c == '-' || c == 'x' || c == 'X')) continue;
+			if (length == 5) return 0;
+			text[length++] = (c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+		}
+		if (length < 4) return 0;
+		
+		// Parse values
+		from = parseSquare(std::string_view(text, 2));
+		to = parseSquare(std::string_view(text + 2, 2));
+		if (from >= 64 || to >= 64) return 0;
+		if (length == 5) {
+			special = Data::move_promotion_knight + std::distance(promote, std::find(promote, promote+4, text[4]));
+			if (special > Data::move_promotion_queen) return 0;
+		} else if ((board_[from] & mask_piecetype) == pawn) {
+			if (board_[to] == nothing && ((from-to) % 8) != 0) {
+				special = Data::move_enpassant_capture;
+			} else if ((from-to) % 16 == 0) {
+				special = Data::move_double_pawn_push;
+			}
+		}
 	}
 	
 	if ((board_[from] & mask_piecetype) == king) {
@@ -715,6 +827,91 @@ string ChessBoard::uciMove(move_t move) const
 	return result;
 }
 
+// Standard algebraic notation, e.g. Nbd7, exd6, e8=Q+, O-O-O#
+string ChessBoard::sanMove(move_t move)
+{
+	static const string pieceToChar = ".PNK?BRQ";
+	
+	square_t from = MOVE_FROM(move);
+	square_t to = MOVE_TO(move);
+	u16 special = MOVE_SPECIAL(move);
+	piece_t type = board_[from] & mask_piecetype;
+	
+	std::vector<move_t> movelist;
+	generateMoves(movelist);
+	
+	string result;
+	if (special == Data::move_castle_kingside) {
+		result = "O-O";
+	} else if (special == Data::move_castle_queenside) {
+		result = "O-O-O";
+	} else {
+		bool capture = (board_[to] != nothing || special == Data::move_enpassant_capture);
+		if (type == pawn) {
+			if (capture) result.push_back('a' + (from % 8));
+		} else {
+			result.push_back(pieceToChar[type]);
+			// Disambiguation by file, rank or both
+			bool ambiguous = false, sameFile = false, sameRank = false;
+			for (move_t other : movelist) {
+				square_t otherFrom = MOVE_FROM(other);
+				if (MOVE_TO(other) != to || otherFrom == from || (board_[otherFrom] & mask_piecetype) != type) continue;
+				ambiguous = true;
+				sameFile |= (otherFrom % 8 == from % 8);
+				sameRank |= (otherFrom / 8 == from / 8);
+			}
+			if (ambiguous && (!sameFile || sameRank)) result.push_back('a' + (from % 8));
+			if (ambiguous && sameFile) result.push_back('1' + (from / 8));
+		}
+		if (capture) result.push_back('x');
+		result += nameSquare(to);
+		if (isPromotion(move)) {
+			result.push_back('=');
+			result.push_back("NBRQ"[special - Data::move_promotion_knight]);
+		}
+	}
+	
+	doMove(move);
+	if (isKingAttacked(player_)) {
+		movelist.clear();
+		generateMoves(movelist);
+		result.push_back(movelist.empty() ? '#' : '+');
+	}
+	undoMove(move);
+	return result;
+}
+
+// Accepts standard algebraic notation and the formats of parseMove. Check and
+// annotation symbols are ignored. Returns 0 for illegal or ambiguous moves.
+move_t ChessBoard::parseSAN(string move)
+{
+	move.erase(std::remove_if(move.begin(), move.end(),
+		[](char c) { return c == '+' || c == '#' || c == '!' || c == '?' || c == '='; }), move.end());
+	if (move == "0-0" || move == "0-0-0") std::replace(move.begin(), move.end(), '0', 'O');
+	
+	std::vector<move_t> movelist;
+	generateMoves(movelist);
+	
+	move_t result = 0;
+	for (move_t candidate : movelist) {
+		string san = sanMove(candidate);
+		san.erase(std::remove_if(san.begin(), san.end(),
+			[](char c) { return c == '+' || c == '#' || c == '='; }), san.end());
+		if (san == move) {
+			if (result) return 0;
+			result = candidate;
+		}
+	}
+	if (result || move.length() < 4) return result;
+	
+	// Coordinate notation
+	move_t coordinate = parseMove(move);
+	for (move_t candidate : movelist) {
+		if ((candidate & 0xffff) == (coordinate & 0xffff) && coordinate) return candidate;
+	}
+	return 0;
+}
+
 // Performs a quick check whether a move is valid
 // Does NOT check against all possible errors
 bool ChessBoard::isValidMove(move_t move) const
@@ -722,7 +919,7 @@ bool ChessBoard::isValidMove(move_t move) const
 	square_t from = MOVE_FROM(move);
 	square_t to = MOVE_TO(move);
 	u16 special = MOVE_SPECIAL(move);
-
+	
 	// Check moving piece and target square
 	if (board_[from] == nothing) return false;
 	if ((board_[from] & mask_color) != player_) return false;
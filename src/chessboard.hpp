@@ -1,11 +1,16 @@
 #pragma once
 
 #include <iostream>
-#include <stack>
+#include <string_view>
 #include <vector>
 #include "data.hpp"
+#include "magic.hpp"
+#include "nnue.hpp"
 #include "types.hpp"
 
+// Forward declarations
+class Tokens;
+
 struct HistoryInfo
 {
 	u8 capture;
@@ -54,8 +59,12 @@ class ChessBoard
 {
 public:
 	// Set position
-	bool setPosition(const tokenizer& tokens, tokenizer::iterator& token);
+	bool setPosition(std::string_view position);
+	bool setFEN(std::string_view fen);
+	bool playMoves(std::string_view moves);
 	void setInitialPosition();
+	// Position without castling and en passant rights (used to generate endgames)
+	void setPieces(const square_t* squares, const piece_t* pieces, int count, player_t player);
 	
 	// Generate moves
 	void generateMoves(std::vector<move_t>& movelist);
@@ -63,12 +72,22 @@ public:
 	void generateAttacks(std::vector<move_t>& movelist) const;
 	void sortMoves(std::vector<move_t>& movelist, move_t sortFirst) const;
 	bool isKingAttacked(player_t color) const;
+	int isSquareAttacked(square_t square, player_t color) const;
 	
 	// Perform moves
 	void doMove(move_t move);
 	void undoMove(move_t move);
 	bool isValidMove(move_t move) const;
 	bool lastMoveWasQuiet() const;
+	bool isRepetition() const;
+	piece_t capturedPiece(move_t move) const;
+	bool isPromotion(move_t move) const;
+	
+	// Neural network evaluation: keeps the accumulators up to date while set
+	void setNetwork(const NNUE::Network* network);
+	
+	// Key of the position in Polyglot opening books
+	u64 polyglotKey() const;
 	
 	// Debug printing
 	void printBoard(std::ostream& out) const;
@@ -78,8 +97,10 @@ public:
 	
 	// Parsing
 	static std::string nameSquare(square_t square);
-	move_t parseMove(std::string move) const;
+	move_t parseMove(std::string_view move) const;
 	std::string uciMove(move_t move) const;
+	std::string sanMove(move_t move);
+	move_t parseSAN(std::string move);
 	
 	// Position data
 	bitboard_t occupied_;
@@ -94,8 +115,11 @@ public:
 	u8 drawmoves_;		// Counter for 50-move draw
 	u16 movenumber_;	// Current move number (starts at 1, increases after black's move)
 	
-	std::stack<HistoryInfo> history_;
+	std::vector<HistoryInfo> history_;
 	
+	const NNUE::Network* network_ = nullptr;
+	NNUE::Accumulator accumulator_;
+
 private:
 	// Generate moves
 	void generateMovesKing(std::vector<move_t>& movelist, bitboard_t allowed) const;
@@ -103,16 +127,16 @@ private:
 	void generateMovesSliding(std::vector<move_t>& movelist, piece_t type, bitboard_t allowed) const;
 	void generateMovesPawn(std::vector<move_t>& movelist, bool captures_only) const;
 	void generateCastles(std::vector<move_t>& movelist) const;
-	int isSquareAttacked(square_t square, player_t color) const;
 	bool leavesKingInCheck(move_t move);
 	
 	// Set position
 	void rebuildZobrist();
-	bool parseFEN(const std::string& fen);
-	bool parsePlayer(const std::string& player);
-	bool parseCastling(const std::string& castling);
-	bool parseEnpassant(const std::string& enpassantSquare);
-	static square_t parseSquare(const std::string& square);
+	bool setFEN(Tokens& tokens);
+	bool parseFEN(std::string_view fen);
+	bool parsePlayer(std::string_view player);
+	bool parseCastling(std::string_view castling);
+	bool parseEnpassant(std::string_view enpassantSquare);
+	static square_t parseSquare(std::string_view name);
 	
 	const std::string namePiece[8] = {
 		"nothing", "pawn", "knight", "king", "error", "bishop", "rook", "queen"
@@ -126,6 +150,7 @@ private:
 		mask_[board_[square] & mask_color] &= clear_bit;
 		mask_[board_[square]] &= clear_bit;
 		switch_zobrist(square | (board_[square] << 6));
+		if (network_) update_accumulator(square, board_[square], false);
 		board_[square] = nothing;
 	}
 	
@@ -137,6 +162,7 @@ private:
 		mask_[piece & mask_color] |= set_bit;
 		mask_[piece] |= set_bit;
 		switch_zobrist(square | (piece << 6));
+		if (network_) update_accumulator(square, piece, true);
 		board_[square] = piece;
 	}
 	
@@ -145,4 +171,26 @@ private:
 		zobrist_ ^= Data::zobrist[zobrist_key];
 	}
 	
+	// A moving king invalidates the accumulator of its own perspective, which
+	// is then rebuilt on the next evaluation instead of being updated here
+	inline void update_accumulator(square_t square, piece_t piece, bool add)
+	{
+		using namespace ChessBoardConstants;
+		if (piece == nothing) return;
+		if ((piece & mask_piecetype) == king) {
+			accumulator_.dirty[piece >> 3] = true;
+			return;
+		}
+		for (int perspective = 0; perspective < 2; ++perspective) {
+			if (accumulator_.dirty[perspective]) continue;
+			square_t kingSquare = Magic::firstBit(mask_[(perspective << 3) | king]);
+			int feature = NNUE::featureIndex(perspective, piece, square, kingSquare);
+			if (add) {
+				NNUE::addFeature(*network_, accumulator_.values[perspective], feature);
+			} else {
+				NNUE::removeFeature(*network_, accumulator_.values[perspective], feature);
+			}
+		}
+	}
+
 };
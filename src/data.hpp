@@ -1,10 +1,11 @@
 #pragma once
 
+#include <array>
 #include "types.hpp"
 
 namespace Data
 {
-	
+
 	// Special move types
 	const u8 move_quiet = 0;
 	const u8 move_promotion_knight = 1;
@@ -92,10 +93,11 @@ namespace Data
 	const int prioritySpecial[16] = { 0, -39, -40, -38, 20, 15, 14, 1, 0, 0, 0, 0, 0, 0, 0, 0 };
 	const int priorityMax = 99;
 	
-	extern bitboard_t attacks_king[64];
-	extern bitboard_t attacks_knight[64];
-	extern bitboard_t attacks_pawn_white[64];
-	extern bitboard_t attacks_pawn_black[64];
+	// Attack tables are generated at compile time (see data.cpp)
+	extern const std::array<bitboard_t, 64> attacks_king;
+	extern const std::array<bitboard_t, 64> attacks_knight;
+	extern const std::array<bitboard_t, 64> attacks_pawn_white;
+	extern const std::array<bitboard_t, 64> attacks_pawn_black;
 	
 	// Zobrist format:
 	// 6 bit = square
@@ -105,12 +107,19 @@ namespace Data
 	// black to move	=> 0100111111
 	// castling			=> 010000CCCC
 	// enpassant		=> 1100EEEEEE
+	// The keys come from a fixed seed, so hashes are identical in every run.
 	
 	const u64 zobrist_player = 0x13f;
 	const u64 zobrist_castling = 0x100;
 	const u64 zobrist_enpassant = 0x300;
-	extern u64 zobrist[];
-	
-	void initialize();
+	extern const std::array<u64, 1024> zobrist;
 	
+	// Polyglot keys for opening books:
+	// 0-767	=> piece on square: 64 * kind + square, kind = 2 * piecetype + color
+	//			   (pawn, knight, bishop, rook, queen, king; black = 0, white = 1)
+	// 768-771	=> castling rights K, Q, k, q
+	// 772-779	=> en passant file, only if a pawn can capture
+	// 780		=> white to move
+	extern const std::array<u64, 781> polyglot_random;
+
 };
\ No newline at end of file
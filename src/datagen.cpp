@@ -0,0 +1,241 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <zlib.h>
+
+#include "adjudicator.hpp"
+#include "chessboard.hpp"
+#include "datagen.hpp"
+#include "engine.hpp"
+#include "magic.hpp"
+#include "score.hpp"
+#include "uci.hpp"
+
+// Number of games between two progress reports
+#define REPORT_GAMES 100
+// Number of games between two updates of the progress file
+#define COMMIT_GAMES 10
+
+using std::string;
+using namespace ChessBoardConstants;
+using namespace std::chrono;
+
+namespace
+{
+	const string startPosition = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+	
+	// Settings that change the generated games; a run only continues with the same ones
+	string settingsKey(const DataGenerator::Settings& settings)
+	{
+		std::stringstream ss;
+		ss << "depth " << settings.depth << " nodes " << settings.nodes << " hash " << settings.hashSize;
+		ss << " random " << settings.randomPlies << " seed " << settings.seed << " compress " << settings.compress;
+		for (auto& option : settings.options) ss << " " << option.first << "=" << option.second;
+		return ss.str();
+	}
+	
+	// Games, records and the size of the output they fill, then the settings.
+	// The file is replaced by renaming, so a crash leaves the old or the new one.
+	bool writeProgress(const string& file, u64 games, u64 records, u64 offset, const string& key)
+	{
+		string temporary = file + ".tmp";
+		std::ofstream out(temporary);
+		out << games << " " << records << " " << offset << "\n" << key << "\n";
+		out.close();
+		return out && std::rename(temporary.c_str(), file.c_str()) == 0;
+	}
+	
+	// Plays one game; the records receive the result once the game is over
+	std::vector<TrainingRecord> playGame(Engine& engine, const DataGenerator::Settings& settings, u64 game)
+	{
+		std::vector<TrainingRecord> records;
+		std::mt19937_64 random(settings.seed * 0x9e3779b97f4a7c15ULL + game);
+		
+		engine.newGame();
+		ChessBoard& board = engine.board();
+		board.setFEN(startPosition);
+		
+		SearchLimits limits;
+		limits.depth = (settings.nodes > 0 ? 0 : settings.depth);
+		limits.nodes = settings.nodes;
+		
+		// Random opening
+		std::vector<move_t> movelist;
+		for (int ply = 0; ply < settings.randomPlies; ++ply) {
+			movelist.clear();
+			board.generateMoves(movelist);
+			if (movelist.empty()) return records;
+			board.doMove(movelist[random() % movelist.size()]);
+		}
+		
+		// Result from white's point of view
+		int result = 0;
+		Adjudicator adjudicator;
+		adjudicator.start(board);
+		
+		while (true) {
+			movelist.clear();
+			board.generateMoves(movelist);
+			if (adjudicator.isGameOver(board, movelist, result)) break;
+			
+			engine.Search(limits);
+			move_t move = engine.bestMove();
+			score_t score = engine.bestValue();
+			if (move == 0) break;
+			
+			// Only quiet positions are useful for training static evaluations
+			if (movelist.size() > 1 && !board.isKingAttacked(board.player_) && abs(score) < Score::mate_bound &&
+				board.capturedPiece(move) == nothing && !board.isPromotion(move))
+			{
+				u16 ply = (u16) (settings.randomPlies + adjudicator.ply());
+				records.push_back(DataGenerator::encode(board, score, ply));
+			}
+			
+			if (adjudicator.adjudicate(board, score, result)) break;
+			
+			board.doMove(move);
+			adjudicator.moveMade(board);
+		}
+		
+		for (TrainingRecord& record : records) {
+			record.result = (int8_t) ((record.state & 0x10) ? -result : result);
+		}
+		return records;
+	}
+}
+
+TrainingRecord DataGenerator::encode(const ChessBoard& board, score_t score, u16 ply)
+{
+	TrainingRecord record = {};
+	record.occupied = board.occupied_;
+	record.state = board.castling_ | (board.player_ == black ? 0x10 : 0);
+	record.enpassant = (u8) board.enpassant_;
+	record.score = score;
+	record.ply = ply;
+	record.drawmoves = board.drawmoves_;
+	
+	bitboard_t pieces = board.occupied_;
+	for (int i = 0; pieces && i < 32; ++i) {
+		square_t square = Magic::extractBit(pieces);
+		record.pieces[i / 2] |= board.board_[square] << ((i & 1) * 4);
+	}
+	return record;
+}
+
+void DataGenerator::run(const Settings& settings)
+{
+	// Resume from the progress file of an earlier run
+	string progressFile = settings.output + ".progress";
+	string key = settingsKey(settings);
+	u64 gamesDone = 0;
+	u64 recordsDone = 0;
+	u64 offset = 0;
+	std::error_code error;
+	std::ifstream progress(progressFile);
+	if (progress) {
+		string storedKey;
+		if (!(progress >> gamesDone >> recordsDone >> offset) || !std::getline(progress >> std::ws, storedKey)) {
+			UCIProtocol::sendMessage("info string error: invalid progress file " + progressFile);
+			return;
+		}
+		if (storedKey != key) {
+			UCIProtocol::sendMessage("info string error: settings differ from the interrupted run (" + storedKey + ")");
+			return;
+		}
+	} else if (std::filesystem::file_size(settings.output, error) > 0 && !error) {
+		UCIProtocol::sendMessage("info string error: " + settings.output + " exists without a progress file");
+		return;
+	}
+	if (gamesDone >= settings.games) {
+		UCIProtocol::sendMessage("info string gensfen: all games already done");
+		return;
+	}
+	if (gamesDone > 0) {
+		// Output written after the last progress update is dropped, it may end
+		// with a partial record or gzip member
+		u64 size = std::filesystem::file_size(settings.output, error);
+		if (error || size < offset) {
+			UCIProtocol::sendMessage("info string error: " + settings.output + " is shorter than recorded in " + progressFile);
+			return;
+		}
+		if (size > offset) std::filesystem::resize_file(settings.output, offset, error);
+		if (error) {
+			UCIProtocol::sendMessage("info string error: cannot truncate " + settings.output);
+			return;
+		}
+		UCIProtocol::sendMessage("info string gensfen: resuming after " + std::to_string(gamesDone) + " games");
+	}
+	
+	// Transparent mode ("T") writes the same stream without compression
+	gzFile file = gzopen(settings.output.c_str(), settings.compress ? "ab6" : "abT");
+	if (!file) {
+		UCIProtocol::sendMessage("info string error: cannot open " + settings.output);
+		return;
+	}
+	
+	std::mutex writeMutex;
+	std::map<u64, std::vector<TrainingRecord>> finished;
+	u64 nextWrite = gamesDone;
+	u64 records = 0;
+	std::atomic<u64> next(gamesDone);
+	std::atomic<bool> failed(false);
+	
+	auto startTime = steady_clock::now();
+	
+	// Finishing the gzip member makes the output readable up to the committed
+	// offset; members written later are appended as separate gzip streams
+	auto commit = [&]() {
+		if (gzflush(file, settings.compress ? Z_FINISH : Z_SYNC_FLUSH) != Z_OK) failed = true;
+		if (!failed && !writeProgress(progressFile, nextWrite, recordsDone + records, gzoffset(file), key)) failed = true;
+	};
+	
+	// Finished games are written in order, so that the progress file always
+	// describes a prefix of the games
+	auto worker = [&]() {
+		Engine engine(settings.hashSize, true);
+		for (auto& option : settings.options) engine.setOption(option.first, option.second);
+		
+		for (u64 game = next++; game < settings.games && !failed; game = next++) {
+			std::vector<TrainingRecord> gameRecords = playGame(engine, settings, game);
+			
+			std::lock_guard<std::mutex> lock(writeMutex);
+			finished[game] = std::move(gameRecords);
+			for (auto it = finished.begin(); it != finished.end() && it->first == nextWrite; it = finished.erase(it)) {
+				unsigned size = (unsigned) (it->second.size() * sizeof(TrainingRecord));
+				if (size > 0 && gzwrite(file, it->second.data(), size) != (int) size) failed = true;
+				records += it->second.size();
+				++nextWrite;
+				if (nextWrite % COMMIT_GAMES == 0 && !failed) commit();
+				if (nextWrite % REPORT_GAMES == 0) {
+					std::stringstream ss;
+					ss << "info string gensfen games " << nextWrite << " positions " << (recordsDone + records);
+					UCIProtocol::sendMessage(ss.str());
+				}
+			}
+		}
+	};
+	
+	std::vector<std::thread> threads;
+	for (int i = 1; i < settings.threads; ++i) threads.emplace_back(worker);
+	worker();
+	for (std::thread& thread : threads) thread.join();
+	if (!failed && nextWrite % COMMIT_GAMES != 0) commit();
+	if (gzclose(file) != Z_OK) failed = true;
+	
+	if (failed) UCIProtocol::sendMessage("info string error: writing " + settings.output + " failed");
+	
+	double seconds = std::max(0.001, duration<double>(steady_clock::now() - startTime).count());
+	std::stringstream ss;
+	ss << "Games played    : " << (nextWrite - gamesDone) << " (" << nextWrite << " total)\n";
+	ss << "Positions       : " << records << " (" << (recordsDone + records) << " total)\n";
+	ss << "Time (s)        : " << (u64) seconds << "\n";
+	ss << "Positions/hour/core: " << (u64) (records * 3600 / seconds / settings.threads);
+	UCIProtocol::sendMessage(ss.str());
+}
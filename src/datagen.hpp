@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "types.hpp"
+
+// Forward declarations
+class ChessBoard;
+
+// Training record, 32 bytes, little endian
+#pragma pack(push, 1)
+struct TrainingRecord
+{
+	u64 occupied;		// Occupied squares
+	u8 pieces[16];		// Pieces on the occupied squares in square order, 4 bits each (low nibble first)
+	u8 state;			// Bits 0-3: castling flags, bit 4: black to move
+	u8 enpassant;		// En passant square or 0
+	int16_t score;		// Search score in centipawns for the side to move
+	u16 ply;			// Ply of the game
+	int8_t result;		// Game result for the side to move: 1 win, 0 draw, -1 loss
+	u8 drawmoves;		// Half-moves for the 50-move rule
+};
+#pragma pack(pop)
+
+// Generates training data from self-play games with fixed depth or node limits
+//
+// Every thread plays games with its own engine. Games are written in the order
+// of their game number. A progress file next to the output keeps the number of
+// finished games, the size of the output they fill and the settings, so an
+// interrupted run with the same settings continues where it stopped.
+class DataGenerator
+{
+public:
+	struct Settings {
+		u64 games = 100;
+		int depth = 6;
+		u64 nodes = 0;			// Overrides the depth if set
+		int threads = 1;
+		int hashSize = 16;		// in megabytes, per thread
+		int randomPlies = 8;	// Random opening moves for variety
+		u64 seed = 1;
+		std::string output = "gensfen.bin";
+		bool compress = false;	// gzip compression
+		std::vector<std::pair<std::string, std::string>> options;	// applied to every engine
+	};
+	
+	static void run(const Settings& settings);
+	
+	static TrainingRecord encode(const ChessBoard& board, score_t score, u16 ply);
+
+private:
+	DataGenerator() = delete;
+
+};
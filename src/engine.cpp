@@ -1,119 +1,462 @@
+#include <cstdlib>
 #include <sstream>
 
 #include "engine.hpp"
 #include "evaluator.hpp"
+#include "profiler.hpp"
 #include "score.hpp"
+#include "stdx.hpp"
 
 #define ASPIRATION_WINDOW 100
 #define NULL_MOVE_PRUNING 2
+#define MAX_SEARCH_DEPTH 64
+#define MAX_MULTI_PV 64
+// Largest expected difference between the material estimate and the classical evaluation
+#define LAZY_EVAL_MARGIN 250
+// Captures that cannot raise alpha by winning the piece plus this margin are skipped
+#define DELTA_MARGIN 200
+// Size of the evaluation cache in bytes
+#define EVAL_CACHE_SIZE (1 << 20)
+// Number of nodes between two checks of the search limits (power of two)
+#define CHECK_LIMITS_NODES 1024
+// Longest time without info output; also the delay before currmove is sent
+#define REPORT_INTERVAL_MS 1000
 
 using std::string;
-using namespace std::chrono;
 
-Engine::Engine():hashtable_(64*1024*1024)
+// Hash size is given in megabytes
+Engine::Engine(size_t hashSize, bool quiet)
+	:hashtable_(std::make_shared<TranspositionTable>(hashSize*1024*1024)), evalCache_(EVAL_CACHE_SIZE), quiet_(quiet)
 {
+	if (quiet_) return;
+	std::stringstream ss;
+	ss << "info string hash table initialized: " << hashtable_->size() << " entries, ";
+	ss << ((hashtable_->size() * sizeof(TranspositionTable::HashEntry)) / 1024) << "kb total size";
+	UCIProtocol::sendMessage(ss.str());
 }
 
-void Engine::Search()
+Engine::Engine(std::shared_ptr<TranspositionTable> hashtable)
+	:hashtable_(std::move(hashtable)), evalCache_(EVAL_CACHE_SIZE)
+{
+}
+
+Engine::~Engine()
+{
+	Stop();
+	Wait();
+}
+
+void Engine::newGame()
+{
+	hashtable_->clear();
+	evalCache_.clear();
+}
+
+// Returns false for unknown options or invalid values
+bool Engine::setOption(const string& name, const string& value)
+{
+	if (name == "MultiPV") {
+		int lines = std::atoi(value.c_str());
+		if (lines < 1 || lines > MAX_MULTI_PV) return false;
+		multiPV_ = lines;
+	} else if (name == "Ponder") {
+		// Pondering is controlled by the GUI
+	} else if (name == "UseNNUE" || name == "EvalFile") {
+		bool use = (name == "UseNNUE" ? value == "true" : useNNUE_);
+		string file = (name == "EvalFile" ? value : evalFile_);
+		std::shared_ptr<const NNUE::Network> network;
+		if (use) {
+			network = NNUE::load(file);
+			if (!network) return false;
+		}
+		useNNUE_ = use;
+		evalFile_ = file;
+		network_ = network;
+		board_.setNetwork(network_.get());
+		evalCache_.clear();
+	} else if (name == "Book") {
+		if (value.empty() || value == "<empty>") {
+			book_.close();
+		} else {
+			if (!book_.open(value)) return false;
+			if (!quiet_) UCIProtocol::sendMessage("info string book " + value + " with " + std::to_string(book_.size()) + " entries");
+		}
+	} else if (name == "BookBestMove") {
+		bookBestMove_ = (value == "true");
+	} else if (name == "SyzygyPath") {
+		if (value.empty() || value == "<empty>") {
+			tablebases_.reset();
+		} else {
+			auto tablebases = Syzygy::load(value);
+			if (!tablebases) return false;
+			tablebases_ = tablebases;
+			if (!quiet_) UCIProtocol::sendMessage("info string tablebases with up to " + std::to_string(Syzygy::largest(*tablebases_)) + " pieces");
+		}
+	} else if (name == "BitbasePath") {
+		if (value.empty() || value == "<empty>") {
+			bitbases_.reset();
+		} else {
+			auto bitbases = Bitbases::load(value);
+			if (!bitbases) return false;
+			bitbases_ = bitbases;
+		}
+		evalCache_.clear();
+	} else if (name == "SyzygyProbeDepth") {
+		int depth = std::atoi(value.c_str());
+		if (depth < 1 || depth > 100) return false;
+		syzygyProbeDepth_ = depth;
+	} else if (name == "SyzygyProbeLimit") {
+		int pieces = std::atoi(value.c_str());
+		if (pieces < 0 || pieces > 7) return false;
+		syzygyProbeLimit_ = pieces;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+score_t Engine::evaluate()
+{
+	PROFILE_SCOPE(evaluate);
+	if (network_) return NNUE::evaluate(*network_, board_);
+	return Evaluator::evaluatePosition(board_, bitbases_.get());
+}
+
+// Two-tier evaluation: If the material estimate is far outside the window, it
+// is returned as a bound instead of computing the full evaluation
+score_t Engine::evaluateLazy(score_t alpha, score_t beta)
+{
+	score_t value;
+	if (evalCache_.probe(board_.zobrist_, value)) {
+		++info_.stats.evalCacheHits;
+		return value;
+	}
+	
+	// The margin only holds for the classical evaluation: The network has no
+	// bound on its difference from material, and bitbase wins and losses are
+	// far outside the margin
+	if (!network_ && (!bitbases_ || Magic::count(board_.occupied_) > 4)) {
+		score_t estimate = Evaluator::estimatePosition(board_);
+		if (estimate - LAZY_EVAL_MARGIN >= beta) {
+			++info_.stats.lazyEvaluations;
+			return estimate - LAZY_EVAL_MARGIN;
+		}
+		if (estimate + LAZY_EVAL_MARGIN <= alpha) {
+			++info_.stats.lazyEvaluations;
+			return estimate + LAZY_EVAL_MARGIN;
+		}
+	}
+	++info_.stats.fullEvaluations;
+	value = evaluate();
+	evalCache_.store(board_.zobrist_, value);
+	return value;
+}
+
+void Engine::Search(const SearchLimits& limits)
+{
+	think_ = thinkSearch;
+	IterativeDeepening(limits);
+}
+
+void Engine::Go(const SearchLimits& limits)
+{
+	Wait();
+	// Set before the thread starts, so that an early "stop" or "ponderhit" is not lost
+	think_ = (limits.ponder ? thinkPonder : thinkSearch);
+	thread_ = std::thread(&Engine::IterativeDeepening, this, limits);
+}
+
+// The opponent played the expected move: Continue the search with the real
+// time budget. The search thread notices the change and restarts its clock.
+void Engine::PonderHit()
+{
+	ThinkMode pondering = thinkPonder;
+	think_.compare_exchange_strong(pondering, thinkSearch);
+}
+
+void Engine::Stop()
+{
+	think_ = thinkStop;
+}
+
+void Engine::Wait()
+{
+	if (thread_.joinable()) thread_.join();
+}
+
+void Engine::IterativeDeepening(const SearchLimits& limits)
 {
-	info_.nodesSearched = 0;
 	info_.selectiveDepthReached = 0;
+	info_.stats = SearchStats();
+	info_.nextReport = REPORT_INTERVAL_MS;
+	iterations_.clear();
+	hashtable_->newSearch();
 	
-	search_.maxDepth = 15;
+	search_.maxDepth = MAX_SEARCH_DEPTH;
+	if (limits.mate > 0) search_.maxDepth = std::min(2 * limits.mate - 1, MAX_SEARCH_DEPTH);
+	if (limits.depth > 0) search_.maxDepth = std::min(limits.depth, MAX_SEARCH_DEPTH);
+	search_.maxNodes = limits.nodes;
+	search_.mate = limits.mate;
+	search_.infinite = limits.infinite;
+	search_.pondering = (think_ == thinkPonder);
 	search_.quiescenceDepth = 8;
+	search_.tablebasePieces = (tablebases_ ? std::min(syzygyProbeLimit_, Syzygy::largest(*tablebases_)) : 0);
 	search_.depth = 1;
-	search_.startTime = steady_clock::now();
-	search_.maxTime = 8000;
-	
-	think_ = thinkSearch;
+	search_.aborted = false;
+	timeManager_.start(limits, board_.player_);
+	bool pondered = search_.pondering;
+	if (pondered) ++ponderSearches_;
 	
 	std::vector<move_t> movelist;
 	board_.generateMoves(movelist);
 	
-	if (movelist.size() == 0) {
-		// No move available: Position is checkmate or stalemate
-		UCIProtocol::sendMessage("bestmove 0000");
-		return;
-	} else if (movelist.size() == 1) {
-		// Only one move available: Make it!
-		UCIProtocol::sendMessage("bestmove "+board_.uciMove(movelist[0]));
-		return;
-	}
-	
 	// TODO put this somewhere else??
 	// We store this for when the search cancels in the middle of a new round
 	score_t bestvalue = 0;
 	move_t bestmove = 0;
 	std::vector<move_t> bestpv;
 	
-	while (search_.depth <= search_.maxDepth && abs(bestvalue) < Score::mate_bound)
+	// Only the moves that keep the tablebase result are searched. With DTZ
+	// tables they also make progress, so the search does not need to probe.
+	// Otherwise the probes help to find a winning line.
+	Syzygy::WDL rootResult;
+	bool usedDTZ = false;
+	bool rootInTablebases = (search_.tablebasePieces > 0 &&
+		Syzygy::filterRootMoves(*tablebases_, board_, movelist, rootResult, usedDTZ));
+	score_t tablebaseValue = 0;
+	if (rootInTablebases) {
+		++info_.stats.tbHits;
+		if (usedDTZ || rootResult <= Syzygy::draw) search_.tablebasePieces = 0;
+		tablebaseValue = (rootResult == Syzygy::win ? Score::tablebase_win : rootResult == Syzygy::loss ? -Score::tablebase_win : 0);
+		bestvalue = tablebaseValue;
+	}
+	
+	// The first move in order is played if the search is stopped before it
+	// completed the first root move
+	const auto entry = hashtable_->getEntry(board_.zobrist_);
+	board_.sortMoves(movelist, entry.zobrist == board_.zobrist_ ? entry.move : 0);
+	if (!movelist.empty()) bestmove = movelist[0];
+	
+	// No move available: Position is checkmate or stalemate
+	// Only one move available: Make it!
+	bool searchMoves = movelist.size() > 1 || (movelist.size() == 1 && (search_.infinite || search_.pondering));
+	
+	// Book moves are played without a search
+	if (searchMoves && book_.isOpen() && !search_.infinite && !search_.pondering && !search_.mate) {
+		move_t bookmove = book_.probe(board_, bookBestMove_);
+		if (bookmove) {
+			bestmove = bookmove;
+			searchMoves = false;
+			if (!quiet_) UCIProtocol::sendMessage("info string book move " + board_.uciMove(bookmove));
+		}
+	}
+	
+	// A mate ends the search once the depth covers it: Mate scores from the
+	// hash table can be longer than a mate the shallow search cannot see yet
+	while (searchMoves && search_.depth <= search_.maxDepth &&
+		(abs(bestvalue) < Score::mate_bound || Score::checkmate - abs(bestvalue) >= search_.depth))
 	{
 		// Sort move list; Top half will contain value from previous round
 		std::sort(movelist.begin(), movelist.end(), std::greater<move_t>());
 		
-		score_t alpha = -Score::infinity;
-		score_t beta = Score::infinity;
-		
-		move_t roundmove = 0;
-		std::vector<move_t> roundpv;
-		
-		for (int i=0; i<movelist.size(); ++i)
+		// MultiPV: Every line searches the moves that were not reported yet.
+		// The best one is moved to the front, behind the previously found lines.
+		size_t lines = std::min<size_t>(multiPV_, movelist.size());
+		size_t line = 0;
+		for (; line < lines; ++line)
 		{
-			std::vector<move_t> localpv;
-			board_.doMove(movelist[i]);
-			score_t value = -NegaMax(search_.depth - 1, -beta, -alpha, true, localpv);
-			board_.undoMove(movelist[i]);
+			score_t alpha = -Score::infinity;
+			score_t beta = Score::infinity;
+			
+			size_t roundindex = 0;
+			move_t roundmove = 0;
+			std::vector<move_t> roundpv;
+			
+			for (size_t i=line; i<movelist.size(); ++i)
+			{
+				if (!quiet_ && timeManager_.elapsed() >= REPORT_INTERVAL_MS) {
+					UCIProtocol::sendMessage("info depth " + std::to_string(search_.depth) + " currmove " +
+						board_.uciMove(movelist[i]) + " currmovenumber " + std::to_string(i + 1));
+					UCIProtocol::flush();
+				}
+				
+				std::vector<move_t> localpv;
+				board_.doMove(movelist[i]);
+				score_t value = -NegaMax(search_.depth - 1, -beta, -alpha, true, localpv);
+				board_.undoMove(movelist[i]);
+				if (search_.aborted) break;
+				
+				u32 wide_value = (32768 + value) << 16;
+				movelist[i] &= 0xffff;
+				movelist[i] |= wide_value;
+				
+				if (value > alpha) {
+					alpha = value;
+					roundindex = i;
+					roundmove = movelist[i];
+					roundpv.assign(localpv.begin(), localpv.end());
+				}
+			}
+			
+			// An unfinished round is only used if a move was searched completely.
+			// The first move is the best move of the previous round.
+			if (roundmove == 0) break;
+			std::swap(movelist[line], movelist[roundindex]);
 			
-			u32 wide_value = (32768 + value) << 16;
-			movelist[i] &= 0xffff;
-			movelist[i] |= wide_value;
+			// The tablebase result is reported unless the search found a mate
+			if (rootInTablebases && abs(alpha) < Score::mate_bound) alpha = tablebaseValue;
 			
-			if (value > alpha) {
-				alpha = value;
-				roundmove = movelist[i];
-				roundpv.assign(localpv.begin(), localpv.end());
+			if (line == 0) {
+				bestvalue = alpha;
+				bestmove = roundmove;
+				bestpv.assign(roundpv.begin(), roundpv.end());
+				iterations_.push_back({ search_.depth, bestmove, bestvalue, info_.stats.nodes, timeManager_.elapsed() });
 			}
+			
+			// Display search information
+			if (!quiet_) sendInfo(line + 1, alpha, roundmove, roundpv);
+			if (search_.aborted) break;
 		}
+		if (line == 0) break;
 		
-		bestvalue = alpha;
-		bestmove = roundmove;
-		bestpv.assign(roundpv.begin(), roundpv.end());
-		
-		// Display search information
-		auto milli = duration_cast<milliseconds>(steady_clock::now() - search_.startTime).count();
-		auto nps = (info_.nodesSearched / std::max(1LL, (milli / 1000)));
-		std::stringstream ss;
-		ss << "info depth " << search_.depth << " seldepth " << info_.selectiveDepthReached;
-		ss << " nodes " << info_.nodesSearched << " nps " << nps << " score ";
-		if (abs(bestvalue) < Score::mate_bound) {
-			ss << "cp " << bestvalue;
-		} else {
-			ss << "mate " << ((Score::checkmate - abs(bestvalue) + 1) / 2);
-		}
-		ss << " pv " << board_.uciMove(bestmove);
-		for (move_t move : bestpv) ss << " " << board_.uciMove(move);
-		UCIProtocol::sendMessage(ss.str());
 		++search_.depth;
 		
-		// Stop because maximum search time was exceeded
-		if (milli > search_.maxTime) break;
+		// Stop because of a search limit
+		if (search_.aborted) break;
+		if (search_.mate > 0 && bestvalue > Score::checkmate - 2 * search_.mate) break;
+		checkLimits();
+		bool timeLeft = timeManager_.continueSearch((u16)bestmove, bestvalue);
+		if (!timeLeft && !search_.pondering) break;
 	}
 	
-	UCIProtocol::sendMessage("bestmove " + board_.uciMove(bestmove));
+	// In infinite and ponder mode the best move may only be sent after "stop"
+	// or, when pondering, after "ponderhit"
+	while ((search_.infinite || think_ == thinkPonder) && think_ != thinkStop) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	if (pondered) {
+		// Pondering ends when the search notices "ponderhit" or when it is waiting
+		if (!search_.pondering || think_ == thinkSearch) ++ponderHits_;
+		if (!quiet_) {
+			std::stringstream ss;
+			ss << "info string ponder hits " << ponderHits_ << "/" << ponderSearches_;
+			ss << " (" << (100 * ponderHits_ / ponderSearches_) << "%)";
+			UCIProtocol::sendMessage(ss.str());
+		}
+	}
+	bestMove_ = bestmove;
+	bestValue_ = bestvalue;
 	think_ = thinkStop;
+	
+	if (debug_ && !quiet_) {
+		for (const string& line : info_.stats.report()) UCIProtocol::sendMessage("info string " + line);
+	}
+	
+	if (!quiet_) {
+		string message = "bestmove " + (bestmove ? board_.uciMove(bestmove) : "0000");
+		move_t ponder = (bestmove ? ponderMove(bestmove, bestpv) : 0);
+		if (ponder) {
+			board_.doMove(bestmove);
+			message += " ponder " + board_.uciMove(ponder);
+			board_.undoMove(bestmove);
+		}
+		UCIProtocol::sendMessage(message);
+	}
+}
+
+// The expected reply to the best move: Taken from the principal variation or,
+// if the variation ended early, from the hash table
+move_t Engine::ponderMove(move_t bestmove, const std::vector<move_t>& bestpv)
+{
+	if (!bestpv.empty()) return bestpv[0];
+	
+	move_t ponder = 0;
+	board_.doMove(bestmove);
+	const auto entry = hashtable_->getEntry(board_.zobrist_);
+	if (entry.zobrist == board_.zobrist_ && entry.move) {
+		std::vector<move_t> movelist;
+		board_.generateMoves(movelist);
+		if (stdx::contains(movelist, (move_t)entry.move)) ponder = entry.move;
+	}
+	board_.undoMove(bestmove);
+	return ponder;
+}
+
+// Depth, time, node and hash table information shared by all info lines
+string Engine::searchInfo(int milli) const
+{
+	u64 nps = info_.stats.nodes * 1000 / std::max(1, milli);
+	string message = "depth " + std::to_string(search_.depth);
+	message += " seldepth " + std::to_string(info_.selectiveDepthReached);
+	message += " time " + std::to_string(milli);
+	message += " nodes " + std::to_string(info_.stats.nodes) + " nps " + std::to_string(nps);
+	message += " hashfull " + std::to_string(hashtable_->hashfull());
+	message += " tbhits " + std::to_string(info_.stats.tbHits);
+	return message;
+}
+
+void Engine::sendInfo(int multipv, score_t value, move_t move, const std::vector<move_t>& pv)
+{
+	int milli = timeManager_.elapsed();
+	info_.nextReport = milli + REPORT_INTERVAL_MS;
+	string message = "info " + searchInfo(milli) + " multipv " + std::to_string(multipv) + " score ";
+	if (abs(value) < Score::mate_bound) {
+		message += "cp " + std::to_string(value);
+	} else {
+		message += "mate " + std::to_string(((Score::checkmate - abs(value) + 1) / 2) * (value > 0 ? 1 : -1));
+	}
+	message += " pv " + board_.uciMove(move);
+	for (move_t pvmove : pv) message += " " + board_.uciMove(pvmove);
+	UCIProtocol::sendMessage(message);
+	
+	// A GUI shows the lines while the search is running
+	UCIProtocol::flush();
+}
+
+// Polled every few nodes, so that the hot path only reads search_.aborted
+void Engine::checkLimits()
+{
+	ThinkMode think = think_;
+	
+	// After a ponder hit the clock of the engine is running
+	if (search_.pondering && think == thinkSearch) {
+		search_.pondering = false;
+		timeManager_.restart();
+	}
+	
+	if (think == thinkStop || (!search_.pondering && timeManager_.hardLimitReached()) ||
+		(search_.maxNodes > 0 && info_.stats.nodes >= search_.maxNodes))
+	{
+		search_.aborted = true;
+	}
+	
+	// Progress within an iteration that takes long
+	if (!quiet_) {
+		int milli = timeManager_.elapsed();
+		if (milli >= info_.nextReport) {
+			info_.nextReport = milli + REPORT_INTERVAL_MS;
+			UCIProtocol::sendMessage("info " + searchInfo(milli));
+			UCIProtocol::flush();
+		}
+	}
 }
 
 score_t Engine::NegaMax(int depth, score_t alpha, score_t beta, bool nullmove, std::vector<move_t>& deeppv)
 {
-	++info_.nodesSearched;
+	PROFILE_SCOPE(search);
+	if ((++info_.stats.nodes & (CHECK_LIMITS_NODES - 1)) == 0) checkLimits();
+	if (search_.aborted) return 0;
 	move_t bestMove = 0;
 	
-	// Draw by 50-move rule (= 100 half-moves)
-	if (board_.drawmoves_ == 100) return Score::stalemate;
+	// Draw by 50-move rule (= 100 half-moves) or by repetition: A position
+	// that repeats once is scored as a draw, so the search makes progress
+	if (board_.drawmoves_ == 100 || board_.isRepetition()) return Score::stalemate;
 	
 	// Query hashtable for previous results
-	const auto& entry = hashtable_.getEntry(board_.zobrist_);
+	const auto entry = hashtable_->getEntry(board_.zobrist_);
+	++info_.stats.ttProbes;
 	if (entry.zobrist == board_.zobrist_) {
+		++info_.stats.ttHits;
 		// Hash entry is deep enough to be used directly?
 		if (entry.depth >= depth) {
 			score_t value = entry.value;
@@ -123,24 +466,51 @@ score_t Engine::NegaMax(int depth, score_t alpha, score_t beta, bool nullmove, s
 				value += search_.depth - depth;
 			}
 			if (entry.type == TranspositionTable::hashfExact) {
+				++info_.stats.ttCutoffs;
 				return value;
 			} else if (entry.type == TranspositionTable::hashfBeta) {
 				alpha = std::max(alpha, value);
 			} else if (entry.type == TranspositionTable::hashfAlpha) {
 				beta = std::min(beta, value);
 			}
-			if (alpha >= beta) return value;
+			if (alpha >= beta) {
+				++info_.stats.ttCutoffs;
+				return value;
+			}
 		}
 		// Otherwise just use the previously best move as the first one for searching
 		bestMove = entry.move;
+	} else if (entry.type != TranspositionTable::hashfEmpty) {
+		++info_.stats.ttCollisions;
+	}
+	
+	// Tablebase probe right after a capture or pawn move, when the 50-move
+	// counter is the one the tables assume
+	if (search_.tablebasePieces > 0 && board_.drawmoves_ == 0 && depth >= syzygyProbeDepth_ && !board_.castling_ &&
+		Magic::count(board_.occupied_) <= search_.tablebasePieces)
+	{
+		Syzygy::WDL wdl;
+		if (Syzygy::probeWDL(*tablebases_, board_, wdl)) {
+			++info_.stats.tbHits;
+			int ply = search_.depth - depth;
+			score_t value = (wdl == Syzygy::loss ? -Score::tablebase_win + ply : wdl == Syzygy::win ? Score::tablebase_win - ply : 2 * wdl);
+			TranspositionTable::HashType type = (wdl == Syzygy::loss ? TranspositionTable::hashfAlpha :
+				wdl == Syzygy::win ? TranspositionTable::hashfBeta : TranspositionTable::hashfExact);
+			if (type == TranspositionTable::hashfExact || (type == TranspositionTable::hashfBeta ? value >= beta : value <= alpha)) {
+				if (hashtable_->recordHash(board_.zobrist_, value, type, std::min(depth + 6, MAX_SEARCH_DEPTH), 0)) {
+					++info_.stats.ttStores;
+				}
+				return value;
+			}
+		}
 	}
 	
 	// Reached a leaf of the search. Evaluate the position.
 	if (depth == 0) {
 		if (board_.lastMoveWasQuiet()) {
-			return Evaluator::evaluatePosition(board_);
+			return evaluateLazy(alpha, beta);
 		} else {
-			--info_.nodesSearched;
+			--info_.stats.nodes;
 			return QuiescenceSearch(search_.quiescenceDepth, alpha, beta);
 		}
 	}
@@ -172,6 +542,7 @@ score_t Engine::NegaMax(int depth, score_t alpha, score_t beta, bool nullmove, s
 		board_.doMove(movelist[i]);
 		score_t value = -NegaMax(depth-1, -beta, -alpha, true, localpv);
 		board_.undoMove(movelist[i]);
+		if (search_.aborted) return 0;
 		
 		// Gamma is the best score from this position
 		if (value > gamma) {
@@ -189,6 +560,7 @@ score_t Engine::NegaMax(int depth, score_t alpha, score_t beta, bool nullmove, s
 		// Beta is the worst score the opponent can force on us
 		// It causes cutoffs when we exceed it because the opponent will not play this line
 		if (alpha >= beta) {
+			++info_.stats.cutoffs[SearchStats::cutoffBucket(i)];
 			hashType = TranspositionTable::hashfBeta;
 			break;
 		}
@@ -199,18 +571,23 @@ score_t Engine::NegaMax(int depth, score_t alpha, score_t beta, bool nullmove, s
 	} else if (gamma < -Score::mate_bound) {
 		gamma -= search_.depth - depth;
 	}
-	hashtable_.recordHash(board_.zobrist_, gamma, hashType, depth, board_.movenumber_, bestMove);
+	if (hashtable_->recordHash(board_.zobrist_, gamma, hashType, depth, bestMove)) {
+		++info_.stats.ttStores;
+	}
 	
 	return alpha;
 }
 
 score_t Engine::QuiescenceSearch(int depth, score_t alpha, score_t beta)
 {
+	PROFILE_SCOPE(search);
 	int selectiveDepth = search_.depth + search_.quiescenceDepth - depth;
 	info_.selectiveDepthReached = std::max(info_.selectiveDepthReached, selectiveDepth);
-	++info_.nodesSearched;
+	++info_.stats.qnodes;
+	if ((++info_.stats.nodes & (CHECK_LIMITS_NODES - 1)) == 0) checkLimits();
+	if (search_.aborted) return 0;
 	
-	score_t stand_pat = Evaluator::evaluatePosition(board_);
+	score_t stand_pat = evaluateLazy(alpha, beta);
 	if (stand_pat >= beta || depth == 0) return stand_pat;
 	if (alpha < stand_pat) alpha = stand_pat;
 	
@@ -219,9 +596,17 @@ score_t Engine::QuiescenceSearch(int depth, score_t alpha, score_t beta)
 	board_.sortMoves(movelist, 0);
 	
 	for (move_t move : movelist) {
+		// Delta pruning: Even winning the captured piece for free does not raise alpha
+		piece_t captured = board_.capturedPiece(move) & ChessBoardConstants::mask_piecetype;
+		if (!board_.isPromotion(move) && stand_pat + Score::pieces[captured] / 10 + DELTA_MARGIN <= alpha) {
+			++info_.stats.deltaPruned;
+			continue;
+		}
+		
 		board_.doMove(move);
 		score_t value = -QuiescenceSearch(depth-1, -beta, -alpha);
 		board_.undoMove(move);
+		if (search_.aborted) return 0;
 		
 		if (value > beta) return beta;
 		if (value > alpha) alpha = value;
@@ -1,9 +1,18 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
+#include "bitbases.hpp"
+#include "book.hpp"
 #include "chessboard.hpp"
+#include "evalcache.hpp"
+#include "searchstats.hpp"
+#include "syzygy.hpp"
+#include "timemanager.hpp"
 #include "transpositiontable.hpp"
 #include "uci.hpp"
 
@@ -18,42 +27,133 @@ public:
 		thinkRefute = 3
 	};
 	
-	Engine();
+	// Quiet engines do not report the hash table either
+	Engine(size_t hashSize = 64, bool quiet = false);
+	// Engines searching in parallel may share one hash table
+	Engine(std::shared_ptr<TranspositionTable> hashtable);
+	~Engine();
 	
 	// Engine info
 	std::string name() { return "GinTonic Evolved v0.1"; }
 	std::string author() { return "Alexander Wirth"; }
-	std::vector<std::string> options() { return std::vector<std::string>(); }
+	std::vector<std::string> options() {
+		return {
+			"name Ponder type check default false",
+			"name MultiPV type spin default 1 min 1 max 64",
+			"name UseNNUE type check default false",
+			"name EvalFile type string default gintonic.nnue",
+			"name Book type string default <empty>",
+			"name BookBestMove type check default false",
+			"name SyzygyPath type string default <empty>",
+			"name SyzygyProbeDepth type spin default 1 min 1 max 100",
+			"name SyzygyProbeLimit type spin default 7 min 0 max 7",
+			"name BitbasePath type string default <empty>",
+		};
+	}
+	bool setOption(const std::string& name, const std::string& value);
 	
 	// Note: Race conditions shouldn't matter here
 	bool isDebug() { return debug_; }
 	void setDebug(bool value) { debug_ = value; }
 	
-	// Searching
-	void Search();
+	// Quiet engines do not send any messages (used for benchmarks)
+	void setQuiet(bool value) { quiet_ = value; }
+	
+	// Searching in the calling thread
+	void Search(const SearchLimits& limits);
+	
+	// Searching in a background thread
+	void Go(const SearchLimits& limits);
+	void Stop();
+	void Wait();
+	void PonderHit();
+	
+	void newGame();
+	u64 nodesSearched() const { return info_.stats.nodes; }
+	move_t bestMove() const { return bestMove_; }
+	score_t bestValue() const { return bestValue_; }
+	
+	// Statistics of the last search
+	const SearchStats& stats() const { return info_.stats; }
+	
+	// Best move after every iteration of the last search (for test suites)
+	struct Iteration {
+		int depth;
+		move_t move;
+		score_t value;
+		u64 nodes;
+		int time;		// Milliseconds
+	};
+	const std::vector<Iteration>& iterations() const { return iterations_; }
 	
 	ChessBoard& board() { return board_; }
 	
+	// Static evaluation of the current position with the selected evaluator
+	score_t evaluate();
+	bool usesNNUE() const { return network_ != nullptr; }
+
 private:
+	void IterativeDeepening(const SearchLimits& limits);
 	score_t NegaMax(int depth, score_t alpha, score_t beta, bool nullmove, std::vector<move_t>& deeppv);
 	score_t QuiescenceSearch(int depth, score_t alpha, score_t beta);
+	score_t evaluateLazy(score_t alpha, score_t beta);
+	void checkLimits();
+	std::string searchInfo(int milli) const;
+	void sendInfo(int multipv, score_t value, move_t move, const std::vector<move_t>& pv);
+	move_t ponderMove(move_t bestmove, const std::vector<move_t>& bestpv);
 	
 	ChessBoard board_;
-	TranspositionTable hashtable_;
-	ThinkMode think_ = thinkStop;
+	std::shared_ptr<TranspositionTable> hashtable_;
+	EvalCache evalCache_;
+	TimeManager timeManager_;
+	std::atomic<ThinkMode> think_{thinkStop};
+	std::thread thread_;
 	bool debug_ = false;
+	bool quiet_ = false;
+	int multiPV_ = 1;
+	
+	// Result of the last search
+	move_t bestMove_ = 0;
+	score_t bestValue_ = 0;
+	std::vector<Iteration> iterations_;
+	
+	// Neural network evaluation, disabled while no network is loaded
+	std::shared_ptr<const NNUE::Network> network_;
+	std::string evalFile_ = "gintonic.nnue";
+	bool useNNUE_ = false;
+	
+	// Polyglot opening book, not used while no book is open
+	Book book_;
+	bool bookBestMove_ = false;
+	
+	// Syzygy tablebases, not probed while none are loaded
+	std::shared_ptr<const Syzygy::Tablebases> tablebases_;
+	int syzygyProbeDepth_ = 1;
+	int syzygyProbeLimit_ = 7;
+	
+	// Bitbases of small endgames for the classical evaluation
+	std::shared_ptr<const Bitbases> bitbases_;
+	
+	// Ponder statistics for this session
+	int ponderSearches_ = 0;
+	int ponderHits_ = 0;
 	
 	struct SearchParameters {
-		std::chrono::steady_clock::time_point startTime;
-		int maxTime;
 		int depth;
 		int maxDepth;
+		u64 maxNodes;
+		int mate;
+		bool infinite;
+		bool pondering;
 		int quiescenceDepth;
+		int tablebasePieces;	// Tablebases are probed in positions with up to this many pieces
+		bool aborted;
 	} search_;
 	
 	struct SearchInfo {
-		u32 nodesSearched;
 		int selectiveDepthReached;
+		int nextReport;		// Time of the next periodic info line in milliseconds
+		SearchStats stats;
 	} info_;
-	
-};
\ No newline at end of file
+
+};
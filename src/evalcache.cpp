@@ -0,0 +1,32 @@
+#include <algorithm>
+
+#include "evalcache.hpp"
+
+#define KEY_MASK 0xffffffffffff0000ULL
+#define MIN_ENTRIES (1 << 16)
+
+EvalCache::EvalCache(size_t maxSize)
+{
+	sizeMask_ = 1ULL << 32;
+	while (sizeMask_ > MIN_ENTRIES && sizeMask_ * sizeof(u64) > maxSize) sizeMask_ >>= 1;
+	table_.resize(sizeMask_, 0);
+	--sizeMask_;
+}
+
+void EvalCache::clear()
+{
+	std::fill(table_.begin(), table_.end(), 0);
+}
+
+bool EvalCache::probe(u64 zobrist, score_t& value) const
+{
+	u64 entry = table_[zobrist & sizeMask_];
+	if ((entry ^ zobrist) & KEY_MASK) return false;
+	value = (score_t) (u16) entry;
+	return true;
+}
+
+void EvalCache::store(u64 zobrist, score_t value)
+{
+	table_[zobrist & sizeMask_] = (zobrist & KEY_MASK) | (u16) value;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+#include "types.hpp"
+
+// Remembers static evaluations by zobrist key
+// An entry is a single word: the upper 48 bits of the key and the score in the
+// lower 16 bits. The index is taken from the lower key bits, so the table needs
+// at least 2^16 entries for the whole key to be verified.
+class EvalCache
+{
+public:
+	EvalCache(size_t maxSize);
+	bool probe(u64 zobrist, score_t& value) const;
+	void store(u64 zobrist, score_t value);
+	void clear();
+	
+private:
+	
+	size_t sizeMask_;
+	std::vector<u64> table_;
+	
+};
@@ -1,5 +1,8 @@
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
 
+#include "bitbases.hpp"
 #include "chessboard.hpp"
 #include "evaluator.hpp"
 #include "magic.hpp"
@@ -7,12 +10,49 @@
 
 using namespace ChessBoardConstants;
 
+namespace
+{
+	int distance(square_t a, square_t b)
+	{
+		return std::max(std::abs((a & 7) - (b & 7)), std::abs((a >> 3) - (b >> 3)));
+	}
+	
+	// Known wins without pawns are mated on the edge, in KBNK in a corner of
+	// the bishop's color. The tables alone leave the search without progress.
+	int mopUp(const ChessBoard& board, int known)
+	{
+		if (board.mask_[white | pawn] | board.mask_[black | pawn]) return 0;
+		player_t strong = (known > 0 ? board.player_ : board.player_ ^ opponent);
+		square_t strongKing = Magic::firstBit(board.mask_[strong | king]);
+		square_t weakKing = Magic::firstBit(board.mask_[(strong ^ opponent) | king]);
+		
+		int edge;
+		bitboard_t bishops = board.mask_[strong | bishop];
+		if (bishops) {
+			square_t square = Magic::firstBit(bishops);
+			bool light = ((square & 7) + (square >> 3)) & 1;
+			edge = 7 - (light ? std::min(distance(weakKing, 7), distance(weakKing, 56)) :
+				std::min(distance(weakKing, 0), distance(weakKing, 63)));
+		} else {
+			edge = std::max(std::abs(2 * (weakKing & 7) - 7), std::abs(2 * (weakKing >> 3) - 7)) / 2;
+		}
+		return Score::mop_up_edge * edge + Score::mop_up_kings * (7 - distance(strongKing, weakKing));
+	}
+}
+
 // Calculates a score for the current position from the moving player's point of view
-score_t Evaluator::evaluatePosition(const ChessBoard& board)
+score_t Evaluator::evaluatePosition(const ChessBoard& board, const Bitbases* bitbases)
 {
+	// Endgames against a lone king: Draws are exact, wins keep the evaluation
+	// below as a guide towards the mate
+	int known = 0;
+	if (bitbases && Magic::count(board.occupied_) <= 4 && bitbases->probe(board, known) && known == 0) {
+		return Score::stalemate;
+	}
+	
 	// Value is first calculated as positive for white and negative for black
 	// At the end of the function the result is flipped if it is black's turn
-	score_t value = 0;
+	int value = 0;
 	
 	// Detect endgame
 	u8 nQueens = Magic::count(board.mask_[white | queen] | board.mask_[black | queen]);
@@ -41,7 +81,7 @@ score_t Evaluator::evaluatePosition(const ChessBoard& board)
 			value -= (score_t) ((1.0f - endgame) * Score::king_squares_midgame[square]);
 			value -= (score_t) (endgame * Score::king_squares_endgame[square]);
 			break;
-			
+		
 		// KNIGHTS
 		case white | knight:
 			value += Score::knight_squares[square ^ mirror_square];
@@ -49,7 +89,7 @@ score_t Evaluator::evaluatePosition(const ChessBoard& board)
 		case black | knight:
 			value -= Score::knight_squares[square];
 			break;
-			
+		
 		// BISHOPS
 		case white | bishop:
 			value += Score::bishop_squares[square ^ mirror_square];
@@ -57,13 +97,13 @@ score_t Evaluator::evaluatePosition(const ChessBoard& board)
 		case black | bishop:
 			value -= Score::bishop_squares[square];
 			break;
-			
+		
 		// ROOKS
 		case white | rook:
 			break;
 		case black | rook:
 			break;
-			
+		
 		// QUEENS
 		case white | queen:
 			value += Score::queen_squares[square ^ mirror_square];
@@ -71,7 +111,7 @@ score_t Evaluator::evaluatePosition(const ChessBoard& board)
 		case black | queen:
 			value -= Score::queen_squares[square];
 			break;
-			
+		
 		// PAWNS
 		case white | pawn:
 			value += Score::pawn_squares[square ^ mirror_square];
@@ -84,6 +124,20 @@ score_t Evaluator::evaluatePosition(const ChessBoard& board)
 	
 	// Evaluate other strategic concepts
 	
+	if (board.player_ == black) value = -value;
+	if (!known) return (score_t) (value / 10);
+	return (score_t) (value / 10 + known * (Score::known_win + mopUp(board, known)));
+}
+
+// Cheap estimate of evaluatePosition from material only
+score_t Evaluator::estimatePosition(const ChessBoard& board)
+{
+	score_t value = 0;
+	for (piece_t type : { pawn, knight, bishop, rook, queen }) {
+		int balance = Magic::count(board.mask_[white | type]) - Magic::count(board.mask_[black | type]);
+		value += Score::pieces[type] * balance;
+	}
+	
 	if (board.player_ == black) value = -value;
 	return (value / 10);
-}
\ No newline at end of file
+}
@@ -3,13 +3,15 @@
 #include "types.hpp"
 
 // Forward declarations
+class Bitbases;
 class ChessBoard;
 
 class Evaluator
 {
 public:
-	static score_t evaluatePosition(const ChessBoard& board);
-	
+	static score_t evaluatePosition(const ChessBoard& board, const Bitbases* bitbases = nullptr);
+	static score_t estimatePosition(const ChessBoard& board);
+
 private:
-	
+
 };
\ No newline at end of file
@@ -1,19 +1,27 @@
 #include <iostream>
 #include <memory>
 
-#include "Crafty/MagicMoves.hpp"
-#include "data.hpp"
 #include "engine.hpp"
 #include "random.hpp"
 #include "uci.hpp"
 
-int main()
+int main(int argc, char* argv[])
 {
 	Random::AutoSeed();
-	Data::initialize();
-	initmagicmoves();
 	
-	UCIProtocol uci(std::unique_ptr<Engine>(new Engine()));
+	// Commands given on the command line are executed instead of a UCI session,
+	// e.g. "gintonic bench 6 16 1 json"; only their results are written
+	bool commandLine = argc > 1;
+	UCIProtocol uci(std::unique_ptr<Engine>(new Engine(64, commandLine)));
+	
+	if (commandLine) {
+		std::string command;
+		for (int i = 1; i < argc; ++i) command += std::string(argv[i]) + " ";
+		uci.recvMessage(command);
+		UCIProtocol::flush();
+		return 0;
+	}
+	
 	uci.run();
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "adjudicator.hpp"
+#include "chessboard.hpp"
+#include "engine.hpp"
+#include "match.hpp"
+#include "uci.hpp"
+
+// Number of games between two progress reports
+#define REPORT_GAMES 10
+// Two-sided 95% quantile of the normal distribution
+#define CONFIDENCE_95 1.959963984540054
+
+using std::string;
+using namespace ChessBoardConstants;
+using namespace std::chrono;
+
+namespace
+{
+	const string startPosition = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+	
+	// Results from the point of view of the first configuration
+	struct Results
+	{
+		u64 wins = 0;
+		u64 draws = 0;
+		u64 losses = 0;
+		
+		u64 games() const { return wins + draws + losses; }
+		double score() const { return (wins + 0.5 * draws) / games(); }
+		
+		// Variance of the result of a single game
+		double variance() const
+		{
+			double s = score();
+			return (wins * (1.0 - s) * (1.0 - s) + draws * (0.5 - s) * (0.5 - s) + losses * s * s) / games();
+		}
+		
+		// Log-likelihood ratio of elo1 against elo0, normal approximation
+		double llr(double elo0, double elo1) const
+		{
+			double var = variance();
+			if (games() == 0 || var <= 0.0) return 0.0;
+			double s0 = expectedScore(elo0);
+			double s1 = expectedScore(elo1);
+			return games() * (s1 - s0) * (2.0 * score() - s0 - s1) / (2.0 * var);
+		}
+		
+		static double expectedScore(double elo) { return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0)); }
+		
+		static double elo(double score)
+		{
+			score = std::min(std::max(score, 1e-6), 1.0 - 1e-6);
+			return -400.0 * std::log10(1.0 / score - 1.0);
+		}
+	};
+	
+	std::vector<string> loadOpenings(const string& path)
+	{
+		std::vector<string> openings;
+		std::ifstream in(path);
+		ChessBoard board;
+		string line;
+		while (std::getline(in, line)) {
+			if (!line.empty() && board.setFEN(line)) openings.push_back(line);
+		}
+		return openings;
+	}
+	
+	// Plays one game and returns the result from white's point of view
+	int playGame(Engine* engines[2], const string& opening, u64 pair, const Match::Settings& settings)
+	{
+		std::mt19937_64 random(settings.seed * 0x9e3779b97f4a7c15ULL + pair);
+		for (int i = 0; i < 2; ++i) {
+			engines[i]->newGame();
+			engines[i]->board().setFEN(opening);
+		}
+		ChessBoard& board = engines[0]->board();
+		
+		SearchLimits limits;
+		limits.depth = settings.depth;
+		limits.nodes = settings.nodes;
+		limits.movetime = settings.movetime;
+		
+		// Both games of a pair start with the same random moves
+		std::vector<move_t> movelist;
+		if (settings.openings.empty()) {
+			for (int ply = 0; ply < settings.randomPlies; ++ply) {
+				movelist.clear();
+				board.generateMoves(movelist);
+				if (movelist.empty()) break;
+				move_t move = movelist[random() % movelist.size()];
+				for (int i = 0; i < 2; ++i) engines[i]->board().doMove(move);
+			}
+		}
+		
+		int result = 0;
+		Adjudicator adjudicator;
+		adjudicator.start(board);
+		
+		while (true) {
+			movelist.clear();
+			board.generateMoves(movelist);
+			if (adjudicator.isGameOver(board, movelist, result)) break;
+			
+			Engine* engine = engines[board.player_ == white ? 0 : 1];
+			engine->Search(limits);
+			move_t move = engine->bestMove();
+			if (move == 0) break;
+			
+			// The score is from the side to move, as in the self-play data
+			if (adjudicator.adjudicate(board, engine->bestValue(), result)) break;
+			
+			for (int i = 0; i < 2; ++i) engines[i]->board().doMove(move);
+			adjudicator.moveMade(board);
+		}
+		return result;
+	}
+	
+	string report(const Results& results, const Match::Settings& settings)
+	{
+		double elo = Results::elo(results.score());
+		double margin = CONFIDENCE_95 * std::sqrt(results.variance() / results.games());
+		double low = Results::elo(results.score() - margin);
+		double high = Results::elo(results.score() + margin);
+		
+		std::stringstream ss;
+		ss << std::fixed << std::setprecision(1);
+		ss << "games " << results.games() << " +" << results.wins << " =" << results.draws << " -" << results.losses;
+		ss << " elo " << elo << " +- " << (high - low) / 2;
+		ss << std::setprecision(2) << " llr " << results.llr(settings.elo0, settings.elo1);
+		ss << " (" << std::log(settings.beta / (1.0 - settings.alpha));
+		ss << ", " << std::log((1.0 - settings.beta) / settings.alpha) << ")";
+		return ss.str();
+	}
+}
+
+void Match::run(const Settings& settings)
+{
+	std::vector<string> openings = { startPosition };
+	if (!settings.openings.empty()) {
+		openings = loadOpenings(settings.openings);
+		if (openings.empty()) {
+			UCIProtocol::sendMessage("info string error: no openings in " + settings.openings);
+			return;
+		}
+	}
+	
+	// Without a limit a quick fixed depth keeps the games short
+	Settings gameSettings = settings;
+	if (gameSettings.depth == 0 && gameSettings.nodes == 0 && gameSettings.movetime == 0) gameSettings.depth = 4;
+	
+	double lowerBound = std::log(settings.beta / (1.0 - settings.alpha));
+	double upperBound = std::log((1.0 - settings.beta) / settings.alpha);
+	
+	std::mutex resultMutex;
+	Results results;
+	std::atomic<u64> next(0);
+	std::atomic<bool> finished(false);
+	string conclusion;
+	
+	auto startTime = steady_clock::now();
+	
+	// Game 2n and 2n+1 form a pair with the same opening and swapped colors
+	auto worker = [&]() {
+		Engine first(settings.hashSize, true);
+		Engine second(settings.hashSize, true);
+		Engine* configurations[2] = { &first, &second };
+		for (int i = 0; i < 2; ++i) {
+			for (auto& option : settings.options[i]) configurations[i]->setOption(option.first, option.second);
+		}
+		
+		for (u64 game = next++; game < settings.games && !finished; game = next++) {
+			u64 pair = game / 2;
+			bool firstIsWhite = (game % 2 == 0);
+			Engine* engines[2] = { configurations[firstIsWhite ? 0 : 1], configurations[firstIsWhite ? 1 : 0] };
+			int result = playGame(engines, openings[pair % openings.size()], pair, gameSettings);
+			if (!firstIsWhite) result = -result;
+			
+			std::lock_guard<std::mutex> lock(resultMutex);
+			if (result > 0) ++results.wins;
+			else if (result < 0) ++results.losses;
+			else ++results.draws;
+			
+			if (results.games() % REPORT_GAMES == 0) UCIProtocol::sendMessage("info string match " + report(results, settings));
+			
+			// Games already running are still counted
+			double llr = results.llr(settings.elo0, settings.elo1);
+			if (!finished && (llr <= lowerBound || llr >= upperBound)) {
+				conclusion = (llr >= upperBound ? "H1 accepted" : "H0 accepted");
+				finished = true;
+			}
+		}
+	};
+	
+	std::vector<std::thread> threads;
+	for (int i = 1; i < settings.threads; ++i) threads.emplace_back(worker);
+	worker();
+	for (std::thread& thread : threads) thread.join();
+	
+	if (results.games() == 0) return;
+	double seconds = std::max(0.001, duration<double>(steady_clock::now() - startTime).count());
+	std::stringstream ss;
+	ss << "Games           : " << results.games() << " (+" << results.wins << " =" << results.draws << " -" << results.losses << ")\n";
+	ss << "Result          : " << report(results, settings) << "\n";
+	ss << "SPRT            : elo0 " << settings.elo0 << " elo1 " << settings.elo1 << ", ";
+	ss << (conclusion.empty() ? "inconclusive" : conclusion) << "\n";
+	ss << "Time (s)        : " << (u64) seconds;
+	UCIProtocol::sendMessage(ss.str());
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "types.hpp"
+
+// Plays games between two engine configurations within this process
+//
+// Both configurations are sets of engine options. Every opening is played
+// twice with swapped colors. The result is reported as the Elo difference of
+// the first configuration together with a sequential probability ratio test,
+// which stops the match as soon as one of the hypotheses elo0 and elo1 is
+// accepted.
+class Match
+{
+public:
+	struct Settings {
+		u64 games = 1000;
+		int depth = 0;
+		u64 nodes = 0;
+		int movetime = 0;		// Milliseconds per move
+		int threads = 1;
+		int hashSize = 16;		// in megabytes, per engine
+		std::string openings;	// EPD file; random openings if empty
+		int randomPlies = 8;
+		u64 seed = 1;
+		
+		// SPRT hypotheses and error probabilities
+		double elo0 = 0.0;
+		double elo1 = 5.0;
+		double alpha = 0.05;
+		double beta = 0.05;
+		
+		std::vector<std::pair<std::string, std::string>> options[2];
+	};
+	
+	static void run(const Settings& settings);
+
+private:
+	Match() = delete;
+
+};
@@ -0,0 +1,206 @@
+// Microbenchmarks of the board, move generation, evaluation and hash table
+//
+// Usage: microbench [--benchmark_filter=<regex>] [--benchmark_out=<file> --benchmark_out_format=json]
+//
+// The board benchmarks run over the positions of the fixed depth bench, so
+// their numbers are averages over openings, middlegames and endgames. Items
+// are positions, moves or squares, depending on the benchmark.
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "../bench.hpp"
+#include "../chessboard.hpp"
+#include "../evaluator.hpp"
+#include "../transpositiontable.hpp"
+#include "../Crafty/MagicMoves.hpp"
+
+// Keys probed and stored by the hash table benchmarks
+#define TT_KEYS 65536
+
+namespace
+{
+	struct Position
+	{
+		ChessBoard board;
+		std::vector<move_t> moves;		// Legal moves, unsorted
+	};
+	
+	// Positions of the bench, set up once
+	std::vector<Position>& positions()
+	{
+		static std::vector<Position> positions = [] {
+			std::vector<Position> result;
+			for (const auto& fen : Benchmark::positions) {
+				Position position;
+				if (!position.board.setPosition(fen)) continue;
+				position.board.generateMoves(position.moves);
+				result.push_back(std::move(position));
+			}
+			return result;
+		}();
+		return positions;
+	}
+	
+	std::vector<u64> randomKeys()
+	{
+		std::mt19937_64 generator(1);
+		std::vector<u64> keys(TT_KEYS);
+		for (auto& key : keys) key = generator();
+		return keys;
+	}
+}
+
+static void generateMoves(benchmark::State& state)
+{
+	std::vector<move_t> movelist;
+	for (auto _ : state) {
+		for (auto& position : positions()) {
+			movelist.clear();
+			position.board.generateMoves(movelist);
+			benchmark::DoNotOptimize(movelist.data());
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * positions().size());
+}
+BENCHMARK(generateMoves);
+
+static void generateGoodCaptures(benchmark::State& state)
+{
+	std::vector<move_t> movelist;
+	for (auto _ : state) {
+		for (auto& position : positions()) {
+			movelist.clear();
+			position.board.generateGoodCaptures(movelist);
+			benchmark::DoNotOptimize(movelist.data());
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * positions().size());
+}
+BENCHMARK(generateGoodCaptures);
+
+// One item is a move made and taken back
+static void doUndoMove(benchmark::State& state)
+{
+	size_t moves = 0;
+	for (auto& position : positions()) moves += position.moves.size();
+	for (auto _ : state) {
+		for (auto& position : positions()) {
+			for (move_t move : position.moves) {
+				position.board.doMove(move);
+				position.board.undoMove(move);
+			}
+			benchmark::DoNotOptimize(position.board.zobrist_);
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * moves);
+}
+BENCHMARK(doUndoMove);
+
+// Every square attacked by the opponent of the side to move
+static void isSquareAttacked(benchmark::State& state)
+{
+	for (auto _ : state) {
+		int attacked = 0;
+		for (const auto& position : positions()) {
+			player_t opponent = position.board.player_ ^ ChessBoardConstants::opponent;
+			for (square_t square = 0; square < 64; ++square) {
+				attacked += position.board.isSquareAttacked(square, opponent);
+			}
+		}
+		benchmark::DoNotOptimize(attacked);
+	}
+	state.SetItemsProcessed(state.iterations() * positions().size() * 64);
+}
+BENCHMARK(isSquareAttacked);
+
+// Includes copying the unsorted moves into the list
+static void sortMoves(benchmark::State& state)
+{
+	std::vector<move_t> movelist;
+	for (auto _ : state) {
+		for (const auto& position : positions()) {
+			movelist = position.moves;
+			position.board.sortMoves(movelist, 0);
+			benchmark::DoNotOptimize(movelist.data());
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * positions().size());
+}
+BENCHMARK(sortMoves);
+
+static void evaluatePosition(benchmark::State& state)
+{
+	for (auto _ : state) {
+		for (const auto& position : positions()) {
+			benchmark::DoNotOptimize(Evaluator::evaluatePosition(position.board));
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * positions().size());
+}
+BENCHMARK(evaluatePosition);
+
+// Probes of random keys in a filled table; the argument is the size in MB
+static void ttGetEntry(benchmark::State& state)
+{
+	TranspositionTable table(state.range(0) << 20);
+	std::vector<u64> keys = randomKeys();
+	for (u64 key : keys) table.recordHash(key, 0, TranspositionTable::hashfExact, 1, 0);
+	for (auto _ : state) {
+		for (u64 key : keys) benchmark::DoNotOptimize(table.getEntry(key));
+	}
+	state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(ttGetEntry)->Arg(1)->Arg(256);
+
+// Stores of random keys; the argument is the size in MB
+static void ttRecordHash(benchmark::State& state)
+{
+	TranspositionTable table(state.range(0) << 20);
+	std::vector<u64> keys = randomKeys();
+	int depth = 0;
+	for (auto _ : state) {
+		for (u64 key : keys) {
+			benchmark::DoNotOptimize(table.recordHash(key, 0, TranspositionTable::hashfExact, depth, 0));
+		}
+		depth = (depth + 1) & 63;
+	}
+	state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(ttRecordHash)->Arg(1)->Arg(256);
+
+// Attacks of a bishop and a rook on every square of the bench positions
+static void bishopMagic(benchmark::State& state)
+{
+	for (auto _ : state) {
+		bitboard_t attacks = 0;
+		for (const auto& position : positions()) {
+			for (square_t square = 0; square < 64; ++square) {
+				attacks ^= Bmagic(square, position.board.occupied_);
+			}
+		}
+		benchmark::DoNotOptimize(attacks);
+	}
+	state.SetItemsProcessed(state.iterations() * positions().size() * 64);
+}
+BENCHMARK(bishopMagic);
+
+static void rookMagic(benchmark::State& state)
+{
+	for (auto _ : state) {
+		bitboard_t attacks = 0;
+		for (const auto& position : positions()) {
+			for (square_t square = 0; square < 64; ++square) {
+				attacks ^= Rmagic(square, position.board.occupied_);
+			}
+		}
+		benchmark::DoNotOptimize(attacks);
+	}
+	state.SetItemsProcessed(state.iterations() * positions().size() * 64);
+}
+BENCHMARK(rookMagic);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "chessboard.hpp"
+#include "magic.hpp"
+#include "nnue.hpp"
+#include "score.hpp"
+
+using std::string;
+using namespace ChessBoardConstants;
+
+namespace
+{
+	template <typename T>
+	bool readArray(std::istream& in, T* values, size_t count)
+	{
+		in.read(reinterpret_cast<char*>(values), sizeof(T) * count);
+		return (bool) in;
+	}
+	
+	// Dot product of clipped activations [0, 127] with int8 weights
+	// Size must be a multiple of 32. All versions give the same result, because
+	// the int16 pair sums of maddubs cannot saturate for inputs up to 127.
+	inline int32_t dotProduct(const uint8_t* input, const int8_t* weights, int size)
+	{
+#if defined(__AVX2__)
+		const __m256i ones = _mm256_set1_epi16(1);
+		__m256i sum = _mm256_setzero_si256();
+		for (int i = 0; i < size; i += 32) {
+			__m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+			__m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i));
+			sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(in, w), ones));
+		}
+		__m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+		sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4e));
+		sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xb1));
+		return _mm_cvtsi128_si32(sum128);
+#elif defined(__SSSE3__)
+		const __m128i ones = _mm_set1_epi16(1);
+		__m128i sum = _mm_setzero_si128();
+		for (int i = 0; i < size; i += 16) {
+			__m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+			__m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i));
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(in, w), ones));
+		}
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+		return _mm_cvtsi128_si32(sum);
+#elif defined(__SSE2__)
+		// No maddubs: widen both operands to int16 first
+		const __m128i zero = _mm_setzero_si128();
+		__m128i sum = _mm_setzero_si128();
+		for (int i = 0; i < size; i += 16) {
+			__m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+			__m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i));
+			__m128i sign = _mm_cmpgt_epi8(zero, w);
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi8(in, zero), _mm_unpacklo_epi8(w, sign)));
+			sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpackhi_epi8(in, zero), _mm_unpackhi_epi8(w, sign)));
+		}
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+		return _mm_cvtsi128_si32(sum);
+#else
+		int32_t sum = 0;
+		for (int i = 0; i < size; ++i) sum += input[i] * weights[i];
+		return sum;
+#endif
+	}
+	
+	// Clipped ReLU of the accumulator: [0, 127] as uint8
+	inline void clipAccumulator(const int16_t* values, uint8_t* output)
+	{
+#if defined(__AVX2__)
+		const __m256i maximum = _mm256_set1_epi16(127);
+		for (int i = 0; i < NNUE::accumulatorSize; i += 32) {
+			__m256i a = _mm256_min_epi16(_mm256_load_si256(reinterpret_cast<const __m256i*>(values + i)), maximum);
+			__m256i b = _mm256_min_epi16(_mm256_load_si256(reinterpret_cast<const __m256i*>(values + i + 16)), maximum);
+			// packus works per 128 bit lane, the permutation restores the order
+			__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), packed);
+		}
+#elif defined(__SSE2__)
+		const __m128i maximum = _mm_set1_epi16(127);
+		for (int i = 0; i < NNUE::accumulatorSize; i += 16) {
+			__m128i a = _mm_min_epi16(_mm_load_si128(reinterpret_cast<const __m128i*>(values + i)), maximum);
+			__m128i b = _mm_min_epi16(_mm_load_si128(reinterpret_cast<const __m128i*>(values + i + 8)), maximum);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_packus_epi16(a, b));
+		}
+#else
+		for (int i = 0; i < NNUE::accumulatorSize; ++i) {
+			output[i] = (uint8_t) std::min<int16_t>(127, std::max<int16_t>(0, values[i]));
+		}
+#endif
+	}
+	
+	// Hidden layer: output = clip((bias + weights * input) >> weightScaleBits)
+	template <int inputs, int outputs>
+	inline void hiddenLayer(const uint8_t* input, const int8_t (*weights)[inputs], const int32_t* bias, uint8_t* output)
+	{
+		for (int i = 0; i < outputs; ++i) {
+			int32_t sum = bias[i] + dotProduct(input, weights[i], inputs);
+			output[i] = (uint8_t) std::min(127, std::max(0, sum >> NNUE::weightScaleBits));
+		}
+	}
+}
+
+std::shared_ptr<const NNUE::Network> NNUE::load(const string& path)
+{
+	static std::mutex cacheMutex;
+	static std::map<string, std::weak_ptr<const Network>> cache;
+	
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	auto cached = cache[path].lock();
+	if (cached) return cached;
+	
+	std::ifstream in(path, std::ios::binary);
+	if (!in) return nullptr;
+	
+	char magic[4];
+	uint32_t version, dimensions[4];
+	if (!readArray(in, magic, 4) || std::memcmp(magic, "GTNN", 4) != 0) return nullptr;
+	if (!readArray(in, &version, 1) || version != 1) return nullptr;
+	if (!readArray(in, dimensions, 4)) return nullptr;
+	if (dimensions[0] != inputSize || dimensions[1] != accumulatorSize ||
+		dimensions[2] != hidden1Size || dimensions[3] != hidden2Size)
+	{
+		return nullptr;
+	}
+	
+	auto network = std::make_shared<Network>();
+	bool valid = readArray(in, network->inputBias, accumulatorSize) &&
+		readArray(in, &network->inputWeights[0][0], (size_t) inputSize * accumulatorSize) &&
+		readArray(in, network->hidden1Bias, hidden1Size) &&
+		readArray(in, &network->hidden1Weights[0][0], hidden1Size * 2 * accumulatorSize) &&
+		readArray(in, network->hidden2Bias, hidden2Size) &&
+		readArray(in, &network->hidden2Weights[0][0], hidden2Size * hidden1Size) &&
+		readArray(in, &network->outputBias, 1) &&
+		readArray(in, network->outputWeights, hidden2Size);
+	if (!valid || in.peek() != EOF) return nullptr;
+	
+	cache[path] = network;
+	return network;
+}
+
+void NNUE::addFeature(const Network& network, int16_t* accumulator, int feature)
+{
+	const int16_t* weights = network.inputWeights[feature];
+#if defined(__AVX2__)
+	for (int i = 0; i < accumulatorSize; i += 16) {
+		__m256i* acc = reinterpret_cast<__m256i*>(accumulator + i);
+		*acc = _mm256_add_epi16(*acc, _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + i)));
+	}
+#elif defined(__SSE2__)
+	for (int i = 0; i < accumulatorSize; i += 8) {
+		__m128i* acc = reinterpret_cast<__m128i*>(accumulator + i);
+		*acc = _mm_add_epi16(*acc, _mm_load_si128(reinterpret_cast<const __m128i*>(weights + i)));
+	}
+#else
+	for (int i = 0; i < accumulatorSize; ++i) accumulator[i] += weights[i];
+#endif
+}
+
+void NNUE::removeFeature(const Network& network, int16_t* accumulator, int feature)
+{
+	const int16_t* weights = network.inputWeights[feature];
+#if defined(__AVX2__)
+	for (int i = 0; i < accumulatorSize; i += 16) {
+		__m256i* acc = reinterpret_cast<__m256i*>(accumulator + i);
+		*acc = _mm256_sub_epi16(*acc, _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + i)));
+	}
+#elif defined(__SSE2__)
+	for (int i = 0; i < accumulatorSize; i += 8) {
+		__m128i* acc = reinterpret_cast<__m128i*>(accumulator + i);
+		*acc = _mm_sub_epi16(*acc, _mm_load_si128(reinterpret_cast<const __m128i*>(weights + i)));
+	}
+#else
+	for (int i = 0; i < accumulatorSize; ++i) accumulator[i] -= weights[i];
+#endif
+}
+
+void NNUE::refresh(const Network& network, const ChessBoard& board, Accumulator& accumulator, int perspective)
+{
+	int16_t* values = accumulator.values[perspective];
+	std::copy(network.inputBias, network.inputBias + accumulatorSize, values);
+	
+	square_t kingSquare = Magic::firstBit(board.mask_[(perspective << 3) | king]);
+	bitboard_t pieces = board.occupied_ & ~(board.mask_[white | king] | board.mask_[black | king]);
+	while (pieces) {
+		square_t square = Magic::extractBit(pieces);
+		addFeature(network, values, featureIndex(perspective, board.board_[square], square, kingSquare));
+	}
+	accumulator.dirty[perspective] = false;
+}
+
+score_t NNUE::evaluate(const Network& network, ChessBoard& board)
+{
+	Accumulator& accumulator = board.accumulator_;
+	if (accumulator.dirty[0]) refresh(network, board, accumulator, 0);
+	if (accumulator.dirty[1]) refresh(network, board, accumulator, 1);
+	
+	// Side to move first
+	int us = board.player_ >> 3;
+	alignas(64) uint8_t input[2 * accumulatorSize];
+	clipAccumulator(accumulator.values[us], input);
+	clipAccumulator(accumulator.values[us ^ 1], input + accumulatorSize);
+	
+	alignas(64) uint8_t hidden1[hidden1Size];
+	alignas(64) uint8_t hidden2[hidden2Size];
+	hiddenLayer<2 * accumulatorSize, hidden1Size>(input, network.hidden1Weights, network.hidden1Bias, hidden1);
+	hiddenLayer<hidden1Size, hidden2Size>(hidden1, network.hidden2Weights, network.hidden2Bias, hidden2);
+	
+	int32_t output = network.outputBias + dotProduct(hidden2, network.outputWeights, hidden2Size);
+	output /= outputScale;
+	return (score_t) std::min<int32_t>(Score::mate_bound - 1, std::max<int32_t>(-Score::mate_bound + 1, output));
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "types.hpp"
+
+// Forward declarations
+class ChessBoard;
+
+// Efficiently updatable neural network evaluation
+//
+// The input layer uses HalfKP-like features: for both perspectives, every
+// non-king piece is encoded relative to the king of that perspective
+// (king square x 10 piece types x 64 squares). The input layer output is
+// kept in an accumulator per perspective that ChessBoard updates whenever a
+// piece is inserted or removed. Only moves of a king require the
+// accumulator of its perspective to be rebuilt.
+//
+// Network file format (all values little endian):
+//   char[4]            "GTNN"
+//   u32                version (1)
+//   u32[4]             dimensions: 40960, 128, 32, 32
+//   i16[128]           input biases
+//   i16[40960][128]    input weights
+//   i32[32]            hidden layer 1 biases
+//   i8[32][256]        hidden layer 1 weights (side to move first)
+//   i32[32]            hidden layer 2 biases
+//   i8[32][32]         hidden layer 2 weights
+//   i32                output bias
+//   i8[32]             output weights
+namespace NNUE
+{
+	const int kingSquares = 64;
+	const int featureTypes = 10;
+	const int inputSize = kingSquares * featureTypes * 64;
+	const int accumulatorSize = 128;
+	const int hidden1Size = 32;
+	const int hidden2Size = 32;
+	
+	// Hidden layer results are divided by 2^weightScaleBits before clipping,
+	// the output is divided by outputScale to get centipawns
+	const int weightScaleBits = 6;
+	const int outputScale = 16;
+	
+	struct Network
+	{
+		alignas(64) int16_t inputBias[accumulatorSize];
+		alignas(64) int16_t inputWeights[inputSize][accumulatorSize];
+		alignas(64) int32_t hidden1Bias[hidden1Size];
+		alignas(64) int8_t hidden1Weights[hidden1Size][2 * accumulatorSize];
+		alignas(64) int32_t hidden2Bias[hidden2Size];
+		alignas(64) int8_t hidden2Weights[hidden2Size][hidden1Size];
+		int32_t outputBias;
+		alignas(64) int8_t outputWeights[hidden2Size];
+	};
+	
+	// Input layer output for white (0) and black (1)
+	struct Accumulator
+	{
+		alignas(64) int16_t values[2][accumulatorSize];
+		bool dirty[2] = { true, true };
+	};
+	
+	// Loads a network file; networks are cached, so engines using the same
+	// file share one copy. Returns nullptr if the file is missing or invalid.
+	std::shared_ptr<const Network> load(const std::string& path);
+	
+	// Index of a piece on a square, seen from a perspective with its king on kingSquare
+	inline int featureIndex(int perspective, piece_t piece, square_t square, square_t kingSquare)
+	{
+		static const int typeIndex[8] = { -1, 0, 1, -1, -1, 2, 3, 4 };
+		int orient = (perspective ? 56 : 0);
+		int type = typeIndex[piece & 0x7] + ((piece >> 3) == perspective ? 0 : 5);
+		return ((kingSquare ^ orient) * featureTypes + type) * 64 + (square ^ orient);
+	}
+	
+	void addFeature(const Network& network, int16_t* accumulator, int feature);
+	void removeFeature(const Network& network, int16_t* accumulator, int feature);
+	
+	// Rebuilds the accumulator of a perspective from the board
+	void refresh(const Network& network, const ChessBoard& board, Accumulator& accumulator, int perspective);
+	
+	// Evaluates the position from the moving player's point of view
+	score_t evaluate(const Network& network, ChessBoard& board);
+}
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#include "profiler.hpp"
+
+using std::string;
+
+namespace
+{
+	const char* sectionNames[Profiler::sections] = {
+		"search", "generateMoves", "generateCaptures", "leavesKingInCheck", "sortMoves",
+		"doMove", "undoMove", "evaluate", "ttProbe", "ttStore"
+	};
+	
+	// Counters of every thread that ever ran a timer
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<Profiler::Counters>> registry;
+}
+
+Profiler::Counters& Profiler::threadCounters()
+{
+	thread_local Counters* counters = nullptr;
+	if (!counters) {
+		std::lock_guard<std::mutex> lock(registryMutex);
+		registry.push_back(std::make_unique<Counters>());
+		counters = registry.back().get();
+	}
+	return *counters;
+}
+
+bool Profiler::enabled()
+{
+#ifdef ENABLE_PROFILER
+	return true;
+#else
+	return false;
+#endif
+}
+
+// Counters of running threads are read without synchronization; the numbers
+// are only exact while no search is running
+std::vector<string> Profiler::report()
+{
+	Counters total;
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		for (const auto& counters : registry) {
+			for (int i = 0; i < sections; ++i) {
+				total.cycles[i] += counters->cycles[i];
+				total.calls[i] += counters->calls[i];
+			}
+		}
+	}
+	u64 cycles = 0;
+	for (u64 c : total.cycles) cycles += c;
+	
+	std::vector<string> lines;
+	for (int i = 0; i < sections; ++i) {
+		std::stringstream ss;
+		ss << std::left << std::setw(18) << sectionNames[i] << std::right;
+		ss << " calls " << std::setw(12) << total.calls[i];
+		ss << " cycles " << std::setw(14) << total.cycles[i];
+		ss << " per call " << std::setw(6) << (total.calls[i] ? total.cycles[i] / total.calls[i] : 0);
+		ss << " " << std::fixed << std::setprecision(1) << std::setw(5) << (100.0 * total.cycles[i] / std::max<u64>(1, cycles)) << "%";
+		lines.push_back(ss.str());
+	}
+	return lines;
+}
+
+void Profiler::reset()
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for (auto& counters : registry) {
+		for (int i = 0; i < sections; ++i) counters->cycles[i] = counters->calls[i] = 0;
+	}
+}
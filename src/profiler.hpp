@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "types.hpp"
+
+#if defined(ENABLE_PROFILER) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#elif defined(ENABLE_PROFILER)
+#include <chrono>
+#endif
+
+// Cycle profiler for the hot paths of the search, compiled in with
+// -DENABLE_PROFILER. Scoped timers count the time stamp counter cycles of a
+// section without its nested sections, in counters owned by the thread.
+// Without the flag PROFILE_SCOPE expands to nothing.
+namespace Profiler
+{
+	enum Section {
+		search,				// Search code outside of the other sections
+		generateMoves,
+		generateCaptures,
+		leavesKingInCheck,
+		sortMoves,
+		doMove,
+		undoMove,
+		evaluate,
+		ttProbe,
+		ttStore,
+		sections
+	};
+	
+	struct Counters
+	{
+		u64 cycles[sections] = {};
+		u64 calls[sections] = {};
+		u64 nested = 0;		// Cycles of the sections inside the running one
+	};
+	
+	// Counters of the calling thread; they live until the program ends
+	Counters& threadCounters();
+	
+	bool enabled();
+	
+	// Sums of all threads, one line per section
+	std::vector<std::string> report();
+	void reset();
+
+#ifdef ENABLE_PROFILER
+	inline u64 timestamp()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+	
+	class ScopedTimer
+	{
+	public:
+		explicit ScopedTimer(Section section)
+			:counters_(threadCounters()), section_(section), outerNested_(counters_.nested), start_(timestamp())
+		{
+			counters_.nested = 0;
+		}
+		
+		~ScopedTimer()
+		{
+			u64 total = timestamp() - start_;
+			counters_.cycles[section_] += total - counters_.nested;
+			++counters_.calls[section_];
+			counters_.nested = outerNested_ + total;
+		}
+	
+	private:
+		Counters& counters_;
+		Section section_;
+		u64 outerNested_;
+		u64 start_;
+	};
+#endif
+}
+
+#ifdef ENABLE_PROFILER
+#define PROFILE_SCOPE(section) Profiler::ScopedTimer profileTimer(Profiler::section)
+#else
+#define PROFILE_SCOPE(section)
+#endif
@@ -1,3 +1,4 @@
 #include "random.hpp"
 
-mt19937 Random::generator;
\ No newline at end of file
+mt19937 Random::generator;
+std::mutex Random::mutex;
\ No newline at end of file
@@ -1,10 +1,13 @@
 #pragma once
 
 #include <chrono>
+#include <mutex>
 #include <random>
 
 using namespace std;
 
+// The shared generator may be used from several threads. Code that draws
+// often, like the opening book, keeps its own generator seeded from here.
 class Random
 {
 public:
@@ -12,32 +15,38 @@ public:
 	static void AutoSeed()
 	{
 		auto seed = chrono::high_resolution_clock::now().time_since_epoch().count();
+		lock_guard<std::mutex> lock(mutex);
 		generator.seed(static_cast<uint32_t>(seed));
 	}
 	
 	static int Integer(int minInclusive, int maxInclusive)
 	{
+		lock_guard<std::mutex> lock(mutex);
 		return uniform_int_distribution<int>{minInclusive, maxInclusive}(generator);
 	}
 	
-	static int Unsigned(unsigned minInclusive, unsigned maxInclusive)
+	static unsigned Unsigned(unsigned minInclusive, unsigned maxInclusive)
 	{
+		lock_guard<std::mutex> lock(mutex);
 		return uniform_int_distribution<unsigned>{minInclusive, maxInclusive}(generator);
 	}
 	
 	template<typename T>
 	static T Real(T minInclusive, T maxExclusive)
 	{
+		lock_guard<std::mutex> lock(mutex);
 		return uniform_real_distribution<T>{minInclusive, maxExclusive}(generator);
 	}
 	
 	static uint64_t Int64()
 	{
+		lock_guard<std::mutex> lock(mutex);
 		return (((uint64_t)generator()) << 32) | ((uint64_t)generator());
 	}
 
 private:
 	static mt19937 generator;
+	static std::mutex mutex;
 	
 	Random() = delete;
 	
@@ -1,24 +1,40 @@
 #pragma once
 
+// The tuner (tuner/tuner.cpp) is built with TUNING defined, which makes the
+// evaluation parameters modifiable
+#ifdef TUNING
+#define TUNABLE inline
+#else
+#define TUNABLE const
+#endif
+
 namespace Score
 {
-	
+
 	// Special scores
 	const score_t command_stop = 23000;
 	const score_t unknown = 22000;
 	const score_t infinity = 21000;
 	const score_t checkmate = 20000;
 	const score_t mate_bound = 19500;
+	// Tablebase wins are scored below the mates, minus the distance to the root
+	const score_t tablebase_win = 19000;
 	const score_t stalemate = 0;
+	// Bonus for positions that a bitbase knows to be won
+	const score_t known_win = 1000;
+	// Known wins without pawns: Per step of the lone king towards the edge
+	// (the mating corner in KBNK) and per step the kings are closer
+	const score_t mop_up_edge = 20;
+	const score_t mop_up_kings = 10;
 	
 	// White pieces: ___, pawn, knight, king, ___, bishop, rook, queen
 	// Black pieces: ___, pawn, knight, king, ___, bishop, rook, queen
-	const score_t pieces[] = {
+	TUNABLE score_t pieces[] = {
 		0,  1000,  3200, 0, 0,  3300,  5000,  9000,
 		0, -1000, -3200, 0, 0, -3300, -5000, -9000
 	};
 	
-	const score_t pawn_squares[] = {
+	TUNABLE score_t pawn_squares[] = {
 		  0,   0,    0,    0,    0,    0,   0,   0,
 		500, 500,  500,  500,  500,  500, 500, 500,
 		100, 100,  200,  300,  300,  200, 100, 100,
@@ -29,7 +45,7 @@ namespace Score
 		  0,   0,    0,    0,    0,    0,   0,   0
 	};
 	
-	const score_t knight_squares[] = {
+	TUNABLE score_t knight_squares[] = {
 		-500, -400, -300, -300, -300, -300, -400, -500,
 		-400, -200,    0,    0,    0,    0, -200, -400,
 		-300,    0,  100,  150,  150,  100,    0, -300,
@@ -40,7 +56,7 @@ namespace Score
 		-500, -400, -300, -300, -300, -300, -400, -500,
 	};
 	
-	const score_t bishop_squares[] = {
+	TUNABLE score_t bishop_squares[] = {
 		-200, -100, -100, -100, -100, -100, -100, -200,
 		-100,    0,    0,    0,    0,    0,    0, -100,
 		-100,    0,   50,  100,  100,   50,    0, -100,
@@ -51,7 +67,7 @@ namespace Score
 		-200, -100, -100, -100, -100, -100, -100, -200,
 	};
 	
-	const score_t queen_squares[] = {
+	TUNABLE score_t queen_squares[] = {
 		-200, -100, -100, -50, -50, -100, -100, -200,
 		-100,    0,    0,   0,   0,    0,    0, -100,
 		-100,    0,   50,  50,  50,   50,    0, -100,
@@ -62,7 +78,7 @@ namespace Score
 		-200, -100, -100, -50, -50, -100, -100, -200
 	};
 	
-	const score_t king_squares_midgame[] = {
+	TUNABLE score_t king_squares_midgame[] = {
 		-300, -400, -400, -500, -500, -400, -400, -300,
 		-300, -400, -400, -500, -500, -400, -400, -300,
 		-300, -400, -400, -500, -500, -400, -400, -300,
@@ -73,7 +89,7 @@ namespace Score
 		 200,  300,  100,    0,    0,  100,  300,  200
 	};
 	
-	const score_t king_squares_endgame[] = {
+	TUNABLE score_t king_squares_endgame[] = {
 		-500, -400, -300, -200, -200, -300, -400, -500,
 		-300, -200, -100,    0,    0, -100, -200, -300,
 		-300, -100,  200,  300,  300,  200, -100, -300,
@@ -83,4 +99,4 @@ namespace Score
 		-300, -300,    0,    0,    0,    0, -300, -300,
 		-500, -300, -300, -300, -300, -300, -300, -500
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <sstream>
+
+#include "searchstats.hpp"
+
+using std::string;
+
+SearchStats& SearchStats::operator+=(const SearchStats& other)
+{
+	nodes += other.nodes;
+	qnodes += other.qnodes;
+	ttProbes += other.ttProbes;
+	ttHits += other.ttHits;
+	ttCollisions += other.ttCollisions;
+	ttCutoffs += other.ttCutoffs;
+	ttStores += other.ttStores;
+	for (int i = 0; i < cutoffBuckets; ++i) cutoffs[i] += other.cutoffs[i];
+	fullEvaluations += other.fullEvaluations;
+	lazyEvaluations += other.lazyEvaluations;
+	evalCacheHits += other.evalCacheHits;
+	deltaPruned += other.deltaPruned;
+	tbHits += other.tbHits;
+	return *this;
+}
+
+namespace
+{
+	// Share in percent with one decimal
+	string percent(u64 part, u64 total)
+	{
+		u64 permille = 1000 * part / std::max<u64>(1, total);
+		return std::to_string(permille / 10) + "." + std::to_string(permille % 10) + "%";
+	}
+}
+
+std::vector<string> SearchStats::report() const
+{
+	static const char* bucketNames[cutoffBuckets] = { "1", "2", "3", "4", "5-8", "9-16", "17+" };
+	
+	std::vector<string> lines;
+	std::stringstream ss;
+	ss << "nodes " << nodes << " main " << (nodes - qnodes) << " qsearch " << qnodes << " (" << percent(qnodes, nodes) << ")";
+	lines.push_back(ss.str());
+	
+	ss.str("");
+	ss << "tt probes " << ttProbes << " hits " << ttHits << " (" << percent(ttHits, ttProbes) << ")";
+	ss << " collisions " << ttCollisions << " cutoffs " << ttCutoffs << " stores " << ttStores;
+	lines.push_back(ss.str());
+	
+	u64 totalCutoffs = 0;
+	for (u64 n : cutoffs) totalCutoffs += n;
+	ss.str("");
+	ss << "beta cutoffs " << totalCutoffs << " by move";
+	for (int i = 0; i < cutoffBuckets; ++i) ss << " " << bucketNames[i] << ":" << percent(cutoffs[i], totalCutoffs);
+	lines.push_back(ss.str());
+	
+	u64 evaluations = fullEvaluations + lazyEvaluations;
+	ss.str("");
+	ss << "evaluations " << evaluations << " full " << fullEvaluations;
+	ss << " lazy " << lazyEvaluations << " (" << percent(lazyEvaluations, evaluations) << ")";
+	ss << " cache hits " << evalCacheHits;
+	lines.push_back(ss.str());
+	
+	ss.str("");
+	ss << "pruned delta " << deltaPruned << " tbhits " << tbHits;
+	lines.push_back(ss.str());
+	return lines;
+}
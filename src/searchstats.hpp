@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "types.hpp"
+
+// Counters of one search. Every engine keeps its own and only the searching
+// thread writes them, so they need no synchronization. Engines searching in
+// parallel are added up after their searches finished.
+struct SearchStats
+{
+	// Beta cutoffs by the index of the move: 1, 2, 3, 4, 5-8, 9-16, 17+
+	static const int cutoffBuckets = 7;
+	
+	u64 nodes = 0;				// All nodes, including the quiescence search
+	u64 qnodes = 0;
+	
+	u64 ttProbes = 0;
+	u64 ttHits = 0;
+	u64 ttCollisions = 0;		// Probes finding an entry of another position
+	u64 ttCutoffs = 0;			// Hits that ended the search of the node
+	u64 ttStores = 0;			// Writes that passed the replacement scheme
+	
+	u64 cutoffs[cutoffBuckets] = {};
+	
+	u64 fullEvaluations = 0;
+	u64 lazyEvaluations = 0;
+	u64 evalCacheHits = 0;
+	
+	u64 deltaPruned = 0;
+	u64 tbHits = 0;
+	
+	static int cutoffBucket(unsigned index)
+	{
+		return index < 4 ? index : index < 8 ? 4 : index < 16 ? 5 : 6;
+	}
+	
+	SearchStats& operator+=(const SearchStats& other);
+	
+	// Summary lines, e.g. for "info string"
+	std::vector<std::string> report() const;
+};
@@ -0,0 +1,939 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+#include "chessboard.hpp"
+#include "magic.hpp"
+#include "syzygy.hpp"
+
+// Largest tables that exist
+#define MAX_PIECES 7
+// Magic numbers at the start of the files
+#define WDL_MAGIC "\x71\xE8\x23\x5D"
+#define DTZ_MAGIC "\xD7\x66\x0C\xA5"
+
+using std::string;
+using namespace ChessBoardConstants;
+
+// The indexing follows the reference implementation of the table format by
+// Ronald de Man. Pieces are encoded as in the files: 1-6 for pawn, knight,
+// bishop, rook, queen and king, plus 8 for black.
+namespace
+{
+	enum TableType { tableWDL, tableDTZ };
+	
+	// Flags of a table; all but SingleValue only exist in DTZ tables
+	enum TableFlag { flagSTM = 1, flagMapped = 2, flagWinPlies = 4, flagLossPlies = 8, flagWide = 16, flagSingleValue = 128 };
+	
+	// Result of an internal probe
+	enum ProbeState { probeFail = 0, probeOk = 1, probeChangeSTM = -1, probeZeroingBestMove = 2 };
+	
+	// Our piece types to the piece types of the files
+	const int tbType[8] = { 0, 1, 2, 6, 0, 3, 4, 5 };
+	// Piece types of the files to ours
+	const piece_t ourType[7] = { nothing, pawn, knight, bishop, rook, queen, king };
+	
+	int mapPawns[64];
+	int mapB1H1H7[64];
+	int mapA1D1D4[64];
+	int mapKK[10][64];
+	int binomial[6][64];		// [k][n]: k elements from a set of n elements
+	int leadPawnIdx[6][64];		// [number of leading pawns][square]
+	int leadPawnsSize[6][4];	// [number of leading pawns][file a-d]
+	
+	inline int rankOf(int square) { return square >> 3; }
+	inline int fileOf(int square) { return square & 7; }
+	inline int offA1H8(int square) { return rankOf(square) - fileOf(square); }
+	inline bool pawnsBefore(int a, int b) { return mapPawns[a] < mapPawns[b]; }
+	
+	template <typename T>
+	int signOf(T value) { return (T(0) < value) - (value < T(0)); }
+	
+	// Numbers in the files are stored little endian, except the Huffman codes
+	template <typename T>
+	T littleEndian(const void* address)
+	{
+		T value;
+		std::memcpy(&value, address, sizeof(T));
+		return value;
+	}
+	
+	template <typename T>
+	T bigEndian(const void* address)
+	{
+		const u8* bytes = static_cast<const u8*>(address);
+		T value = 0;
+		for (size_t i = 0; i < sizeof(T); ++i) value = (value << 8) | bytes[i];
+		return value;
+	}
+	
+	void initIndexing()
+	{
+		// Squares below the a1-h8 diagonal to 0..27
+		int code = 0;
+		for (int s = 0; s < 64; ++s) {
+			if (offA1H8(s) < 0) mapB1H1H7[s] = code++;
+		}
+		
+		// Squares of the a1-d1-d4 triangle to 0..9, the diagonal last
+		std::vector<int> diagonal;
+		code = 0;
+		for (int s = 0; s <= 27; ++s) {
+			if (offA1H8(s) < 0 && fileOf(s) <= 3) mapA1D1D4[s] = code++;
+			else if (!offA1H8(s) && fileOf(s) <= 3) diagonal.push_back(s);
+		}
+		for (int s : diagonal) mapA1D1D4[s] = code++;
+		
+		// The 462 legal placements of two kings with the first one in the
+		// a1-d1-d4 triangle. Both kings on the diagonal are encoded last.
+		std::vector<std::pair<int, int>> bothOnDiagonal;
+		code = 0;
+		for (int idx = 0; idx < 10; ++idx) {
+			for (int s1 = 0; s1 <= 27; ++s1) {
+				if (mapA1D1D4[s1] != idx || (idx == 0 && s1 != 1)) continue;
+				for (int s2 = 0; s2 < 64; ++s2) {
+					if (abs(rankOf(s1) - rankOf(s2)) <= 1 && abs(fileOf(s1) - fileOf(s2)) <= 1) continue;
+					if (!offA1H8(s1) && offA1H8(s2) > 0) continue;
+					if (!offA1H8(s1) && !offA1H8(s2)) bothOnDiagonal.emplace_back(idx, s2);
+					else mapKK[idx][s2] = code++;
+				}
+			}
+		}
+		for (auto& p : bothOnDiagonal) mapKK[p.first][p.second] = code++;
+		
+		binomial[0][0] = 1;
+		for (int n = 1; n < 64; ++n) {
+			for (int k = 0; k < 6 && k <= n; ++k) {
+				binomial[k][n] = (k > 0 ? binomial[k - 1][n - 1] : 0) + (k < n ? binomial[k][n - 1] : 0);
+			}
+		}
+		
+		// Pawn squares a2-h7 to 47..0, so that the leading pawn (nearest to the
+		// edge, then lowest rank) has the highest value
+		int available = 47;
+		for (int leadPawns = 1; leadPawns <= 5; ++leadPawns) {
+			for (int file = 0; file < 4; ++file) {
+				int idx = 0;
+				for (int rank = 1; rank <= 6; ++rank) {
+					int s = rank * 8 + file;
+					if (leadPawns == 1) {
+						mapPawns[s] = available--;
+						mapPawns[s ^ 7] = available--;
+					}
+					leadPawnIdx[leadPawns][s] = idx;
+					idx += binomial[leadPawns - 1][mapPawns[s]];
+				}
+				leadPawnsSize[leadPawns][file] = idx;
+			}
+		}
+	}
+	
+	// Material of both colors, 4 bits per piece type
+	u64 materialKey(const int counts[2][7])
+	{
+		u64 key = 0;
+		for (int color = 0; color < 2; ++color) {
+			for (int type = 1; type <= 6; ++type) key |= (u64) counts[color][type] << (4 * (color * 6 + type - 1));
+		}
+		return key;
+	}
+	
+	u64 materialKey(const ChessBoard& board)
+	{
+		int counts[2][7] = {};
+		for (int color = 0; color < 2; ++color) {
+			for (int type = 1; type <= 6; ++type) counts[color][type] = Magic::count(board.mask_[ourType[type] | (color * 8)]);
+		}
+		return materialKey(counts);
+	}
+	
+	// Huffman symbol
+	typedef u16 Symbol;
+	
+	// Left and right child of a symbol, 12 bits each
+	struct PairNode
+	{
+		u8 lr[3];
+		Symbol left() const { return ((lr[1] & 0xf) << 8) | lr[0]; }
+		Symbol right() const { return (lr[2] << 4) | (lr[1] >> 4); }
+	};
+	
+	// Block number and offset within the block, little endian
+	struct SparseEntry
+	{
+		char block[4];
+		char offset[2];
+	};
+	
+	// Decoding information of one part of a table. Tables have parts for each
+	// side to move and, with pawns, for each file of the leading pawn.
+	struct PairsData
+	{
+		u8 flags;
+		size_t blockSize;
+		size_t span;			// Values between two sparse index entries
+		int numBlocks;
+		int maxSymbolLength;
+		int minSymbolLength;
+		const Symbol* lowestSymbol;
+		const PairNode* tree;
+		const u16* blockLength;	// Number of values minus one per block
+		int blockLengthSize;
+		const SparseEntry* sparseIndex;
+		size_t sparseIndexSize;
+		const u8* data;
+		std::vector<u64> base64;
+		std::vector<u8> symbolLength;	// Number of values minus one per symbol
+		int pieces[MAX_PIECES];
+		u64 groupIdx[MAX_PIECES + 1];
+		int groupLength[MAX_PIECES + 1];
+		u16 mapIdx[4];			// Win, loss, cursed win, blessed loss (DTZ only)
+	};
+	
+	struct Table
+	{
+		TableType type;
+		string name;			// e.g. "KRvK"
+		u64 key;				// Material with the first side as white
+		u64 key2;				// Material with the first side as black
+		int pieceCount;
+		bool hasPawns;
+		bool hasUniquePieces;
+		u8 pawnCount[2];		// Leading color, other color
+		
+		std::atomic<bool> ready{false};
+		void* address = nullptr;
+		size_t mappedSize = 0;
+		const u8* map = nullptr;
+		PairsData items[2][4];	// [side to move][file of the leading pawn]
+		
+		int sides() const { return type == tableWDL ? 2 : 1; }
+		PairsData* get(int stm, int file) { return &items[stm % sides()][hasPawns ? file : 0]; }
+		
+		~Table()
+		{
+			if (address) munmap(address, mappedSize);
+		}
+	};
+	
+	// Blocks of Huffman codes may end with one or more values of a symbol that
+	// expands into several values. The sparse index points to blocks near the
+	// requested value, which are then walked to the right one.
+	int decompressPairs(PairsData* d, u64 idx)
+	{
+		if (d->flags & flagSingleValue) return d->minSymbolLength;
+		
+		u32 k = (u32) (idx / d->span);
+		u32 block = littleEndian<u32>(&d->sparseIndex[k].block);
+		int offset = littleEndian<u16>(&d->sparseIndex[k].offset);
+		offset += (int) (idx % d->span) - (int) (d->span / 2);
+		
+		while (offset < 0) offset += d->blockLength[--block] + 1;
+		while (offset > d->blockLength[block]) offset -= d->blockLength[block++] + 1;
+		
+		const u8* ptr = d->data + (u64) block * d->blockSize;
+		u64 buffer = bigEndian<u64>(ptr);
+		ptr += 8;
+		int bufferSize = 64;
+		Symbol symbol;
+		
+		while (true) {
+			// Symbols of one length are consecutive numbers with the longer
+			// ones below the shorter ones
+			int length = 0;
+			while (buffer < d->base64[length]) ++length;
+			symbol = (Symbol) ((buffer - d->base64[length]) >> (64 - length - d->minSymbolLength));
+			symbol += littleEndian<Symbol>(&d->lowestSymbol[length]);
+			
+			if (offset < d->symbolLength[symbol] + 1) break;
+			
+			offset -= d->symbolLength[symbol] + 1;
+			length += d->minSymbolLength;
+			buffer <<= length;
+			bufferSize -= length;
+			if (bufferSize <= 32) {
+				bufferSize += 32;
+				buffer |= (u64) bigEndian<u32>(ptr) << (64 - bufferSize);
+				ptr += 4;
+			}
+		}
+		
+		// Symbols are pairs of adjacent symbols: descend to the value
+		while (d->symbolLength[symbol]) {
+			Symbol left = d->tree[symbol].left();
+			if (offset < d->symbolLength[left] + 1) {
+				symbol = left;
+			} else {
+				offset -= d->symbolLength[left] + 1;
+				symbol = d->tree[symbol].right();
+			}
+		}
+		return d->tree[symbol].left();
+	}
+	
+	// DTZ tables only store one side to move
+	bool checkDTZSide(Table& table, int stm, int file)
+	{
+		if (table.type == tableWDL) return true;
+		int flags = table.get(stm, file)->flags;
+		return (flags & flagSTM) == stm || (table.key == table.key2 && !table.hasPawns);
+	}
+	
+	// DTZ values are remapped by frequency per result and may be stored in moves
+	int mapScore(Table& table, int file, int value, Syzygy::WDL wdl)
+	{
+		if (table.type == tableWDL) return value - 2;
+		
+		static const int wdlMap[] = { 1, 3, 0, 2, 0 };
+		PairsData* d = table.get(0, file);
+		if (d->flags & flagMapped) {
+			int index = d->mapIdx[wdlMap[wdl + 2]] + value;
+			if (d->flags & flagWide) value = littleEndian<u16>(table.map + 2 * index);
+			else value = table.map[index];
+		}
+		if ((wdl == Syzygy::win && !(d->flags & flagWinPlies)) || (wdl == Syzygy::loss && !(d->flags & flagLossPlies)) ||
+			wdl == Syzygy::cursedWin || wdl == Syzygy::blessedLoss)
+		{
+			value *= 2;
+		}
+		return value + 1;
+	}
+	
+	// Index of the position in the table: The leading group (pawns or up to
+	// three pieces) is mapped into a canonical triangle, the remaining groups
+	// of equal pieces are encoded as combinations of the free squares
+	int probeTable(const ChessBoard& board, Table& table, Syzygy::WDL wdl, ProbeState& state)
+	{
+		int squares[MAX_PIECES];
+		int pieces[MAX_PIECES];
+		int size = 0;
+		int leadPawnsCount = 0;
+		bitboard_t leadPawns = 0;
+		int tbFile = 0;
+		u64 idx;
+		
+		// Tables are stored with the stronger side as white; symmetric tables
+		// only with white to move
+		bool blackToMove = (board.player_ == black);
+		bool symmetricBlackToMove = (table.key == table.key2 && blackToMove);
+		bool blackStronger = (materialKey(board) != table.key);
+		bool flip = (symmetricBlackToMove || blackStronger);
+		int flipColor = flip ? 8 : 0;
+		int flipSquares = flip ? 56 : 0;
+		int stm = (int) flip ^ (int) blackToMove;
+		
+		// The leading pawn decides which of the four file tables is used
+		if (table.hasPawns) {
+			int leadColor = (table.get(0, 0)->pieces[0] ^ flipColor) & 8;
+			leadPawns = board.mask_[leadColor | pawn];
+			bitboard_t b = leadPawns;
+			while (b) squares[size++] = Magic::extractBit(b) ^ flipSquares;
+			leadPawnsCount = size;
+			std::swap(squares[0], *std::max_element(squares, squares + leadPawnsCount, pawnsBefore));
+			tbFile = std::min(fileOf(squares[0]), 7 - fileOf(squares[0]));
+		}
+		
+		if (!checkDTZSide(table, stm, tbFile)) {
+			state = probeChangeSTM;
+			return 0;
+		}
+		
+		bitboard_t b = board.occupied_ ^ leadPawns;
+		while (b) {
+			int s = Magic::extractBit(b);
+			piece_t piece = board.board_[s];
+			squares[size] = s ^ flipSquares;
+			pieces[size++] = (tbType[piece & mask_piecetype] | (piece & mask_color)) ^ flipColor;
+		}
+		
+		PairsData* d = table.get(stm, tbFile);
+		
+		// Same order of the pieces as in the table
+		for (int i = leadPawnsCount; i < size - 1; ++i) {
+			for (int j = i + 1; j < size; ++j) {
+				if (d->pieces[i] == pieces[j]) {
+					std::swap(pieces[i], pieces[j]);
+					std::swap(squares[i], squares[j]);
+					break;
+				}
+			}
+		}
+		
+		if (fileOf(squares[0]) > 3) {
+			for (int i = 0; i < size; ++i) squares[i] ^= 7;
+		}
+		
+		if (table.hasPawns) {
+			idx = leadPawnIdx[leadPawnsCount][squares[0]];
+			std::stable_sort(squares + 1, squares + leadPawnsCount, pawnsBefore);
+			for (int i = 1; i < leadPawnsCount; ++i) idx += binomial[i][mapPawns[squares[i]]];
+		} else {
+			if (rankOf(squares[0]) > 3) {
+				for (int i = 0; i < size; ++i) squares[i] ^= 56;
+			}
+			
+			// The first piece of the leading group off the a1-h8 diagonal is
+			// mirrored below it
+			for (int i = 0; i < d->groupLength[0]; ++i) {
+				if (!offA1H8(squares[i])) continue;
+				if (offA1H8(squares[i]) > 0) {
+					for (int j = i; j < size; ++j) squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+				}
+				break;
+			}
+			
+			if (table.hasUniquePieces) {
+				int adjust1 = (squares[1] > squares[0]);
+				int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+				if (offA1H8(squares[0])) {
+					idx = (mapA1D1D4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+				} else if (offA1H8(squares[1])) {
+					idx = (6 * 63 + rankOf(squares[0]) * 28 + mapB1H1H7[squares[1]]) * 62 + squares[2] - adjust2;
+				} else if (offA1H8(squares[2])) {
+					idx = 6 * 63 * 62 + 4 * 28 * 62 + rankOf(squares[0]) * 7 * 28 +
+						(rankOf(squares[1]) - adjust1) * 28 + mapB1H1H7[squares[2]];
+				} else {
+					idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + rankOf(squares[0]) * 7 * 6 +
+						(rankOf(squares[1]) - adjust1) * 6 + (rankOf(squares[2]) - adjust2);
+				}
+			} else {
+				idx = mapKK[mapA1D1D4[squares[0]]][squares[1]];
+			}
+		}
+		
+		// Remaining groups in ascending square order, skipping the squares of
+		// the groups before
+		idx *= d->groupIdx[0];
+		int* groupSquares = squares + d->groupLength[0];
+		bool remainingPawns = table.hasPawns && table.pawnCount[1];
+		for (int next = 1; d->groupLength[next]; ++next) {
+			std::stable_sort(groupSquares, groupSquares + d->groupLength[next]);
+			u64 n = 0;
+			for (int i = 0; i < d->groupLength[next]; ++i) {
+				int adjust = (int) std::count_if(squares, groupSquares, [&](int s) { return groupSquares[i] > s; });
+				n += binomial[i + 1][groupSquares[i] - adjust - 8 * remainingPawns];
+			}
+			remainingPawns = false;
+			idx += n * d->groupIdx[next];
+			groupSquares += d->groupLength[next];
+		}
+		
+		return mapScore(table, tbFile, decompressPairs(d, idx), wdl);
+	}
+	
+	// Pieces of one type and color form a group. The leading group holds the
+	// pawns of one side, three unique pieces or the two kings. The order of
+	// the groups in the index is given by the table.
+	void setGroups(Table& table, PairsData* d, const int order[2], int file)
+	{
+		int n = 0;
+		int firstLength = table.hasPawns ? 0 : table.hasUniquePieces ? 3 : 2;
+		d->groupLength[n] = 1;
+		for (int i = 1; i < table.pieceCount; ++i) {
+			if (--firstLength > 0 || d->pieces[i] == d->pieces[i - 1]) d->groupLength[n]++;
+			else d->groupLength[++n] = 1;
+		}
+		d->groupLength[++n] = 0;
+		
+		bool pawnsOnBothSides = table.hasPawns && table.pawnCount[1];
+		int next = pawnsOnBothSides ? 2 : 1;
+		int freeSquares = 64 - d->groupLength[0] - (pawnsOnBothSides ? d->groupLength[1] : 0);
+		u64 idx = 1;
+		for (int k = 0; next < n || k == order[0] || k == order[1]; ++k) {
+			if (k == order[0]) {
+				d->groupIdx[0] = idx;
+				idx *= table.hasPawns ? leadPawnsSize[d->groupLength[0]][file] : table.hasUniquePieces ? 31332 : 462;
+			} else if (k == order[1]) {
+				d->groupIdx[1] = idx;
+				idx *= binomial[d->groupLength[1]][48 - d->groupLength[0]];
+			} else {
+				d->groupIdx[next] = idx;
+				idx *= binomial[d->groupLength[next]][freeSquares];
+				freeSquares -= d->groupLength[next++];
+			}
+		}
+		d->groupIdx[n] = idx;
+	}
+	
+	u8 setSymbolLength(PairsData* d, Symbol s, std::vector<bool>& visited)
+	{
+		visited[s] = true;
+		Symbol right = d->tree[s].right();
+		if (right == 0xfff) return 0;
+		Symbol left = d->tree[s].left();
+		if (!visited[left]) d->symbolLength[left] = setSymbolLength(d, left, visited);
+		if (!visited[right]) d->symbolLength[right] = setSymbolLength(d, right, visited);
+		return d->symbolLength[left] + d->symbolLength[right] + 1;
+	}
+	
+	const u8* setSizes(PairsData* d, const u8* data)
+	{
+		d->flags = *data++;
+		if (d->flags & flagSingleValue) {
+			d->numBlocks = 0;
+			d->span = 0;
+			d->blockLengthSize = 0;
+			d->sparseIndexSize = 0;
+			d->minSymbolLength = *data++;	// The single value
+			return data;
+		}
+		
+		u64 tableSize = d->groupIdx[std::find(d->groupLength, d->groupLength + MAX_PIECES, 0) - d->groupLength];
+		d->blockSize = (size_t) 1 << *data++;
+		d->span = (size_t) 1 << *data++;
+		d->sparseIndexSize = (size_t) ((tableSize + d->span - 1) / d->span);
+		int padding = *data++;
+		d->numBlocks = littleEndian<u32>(data);
+		data += 4;
+		d->blockLengthSize = d->numBlocks + padding;
+		d->maxSymbolLength = *data++;
+		d->minSymbolLength = *data++;
+		d->lowestSymbol = reinterpret_cast<const Symbol*>(data);
+		
+		// Canonical Huffman code: base64[l] is the lowest code of length
+		// l + minSymbolLength, left aligned to 64 bits
+		d->base64.assign(d->maxSymbolLength - d->minSymbolLength + 1, 0);
+		for (int i = (int) d->base64.size() - 2; i >= 0; --i) {
+			d->base64[i] = (d->base64[i + 1] + littleEndian<Symbol>(&d->lowestSymbol[i]) -
+				littleEndian<Symbol>(&d->lowestSymbol[i + 1])) / 2;
+		}
+		for (size_t i = 0; i < d->base64.size(); ++i) d->base64[i] <<= 64 - i - d->minSymbolLength;
+		
+		data += d->base64.size() * sizeof(Symbol);
+		d->symbolLength.assign(littleEndian<u16>(data), 0);
+		data += 2;
+		d->tree = reinterpret_cast<const PairNode*>(data);
+		
+		std::vector<bool> visited(d->symbolLength.size());
+		for (size_t s = 0; s < d->symbolLength.size(); ++s) {
+			if (!visited[s]) d->symbolLength[s] = setSymbolLength(d, (Symbol) s, visited);
+		}
+		return data + d->symbolLength.size() * sizeof(PairNode) + (d->symbolLength.size() & 1);
+	}
+	
+	const u8* setDTZMap(Table& table, const u8* data, int maxFile)
+	{
+		if (table.type == tableWDL) return data;
+		
+		table.map = data;
+		for (int file = 0; file <= maxFile; ++file) {
+			PairsData* d = table.get(0, file);
+			if (!(d->flags & flagMapped)) continue;
+			if (d->flags & flagWide) {
+				data += (uintptr_t) data & 1;
+				for (int i = 0; i < 4; ++i) {
+					d->mapIdx[i] = (u16) ((data - table.map) / 2 + 1);
+					data += 2 * littleEndian<u16>(data) + 2;
+				}
+			} else {
+				for (int i = 0; i < 4; ++i) {
+					d->mapIdx[i] = (u16) (data - table.map + 1);
+					data += *data + 1;
+				}
+			}
+		}
+		return data + ((uintptr_t) data & 1);
+	}
+	
+	// Reads the layout of a mapped file (after the magic number)
+	void setup(Table& table, const u8* data)
+	{
+		data++;		// Flags: split sides, has pawns
+		const int sides = (table.sides() == 2 && table.key != table.key2) ? 2 : 1;
+		const int maxFile = table.hasPawns ? 3 : 0;
+		bool pawnsOnBothSides = table.hasPawns && table.pawnCount[1];
+		
+		for (int file = 0; file <= maxFile; ++file) {
+			for (int i = 0; i < sides; ++i) *table.get(i, file) = PairsData();
+			int order[2][2] = {
+				{ *data & 0xf, pawnsOnBothSides ? *(data + 1) & 0xf : 0xf },
+				{ *data >> 4, pawnsOnBothSides ? *(data + 1) >> 4 : 0xf }
+			};
+			data += 1 + pawnsOnBothSides;
+			for (int k = 0; k < table.pieceCount; ++k, ++data) {
+				for (int i = 0; i < sides; ++i) table.get(i, file)->pieces[k] = (i ? *data >> 4 : *data & 0xf);
+			}
+			for (int i = 0; i < sides; ++i) setGroups(table, table.get(i, file), order[i], file);
+		}
+		data += (uintptr_t) data & 1;
+		
+		for (int file = 0; file <= maxFile; ++file) {
+			for (int i = 0; i < sides; ++i) data = setSizes(table.get(i, file), data);
+		}
+		data = setDTZMap(table, data, maxFile);
+		for (int file = 0; file <= maxFile; ++file) {
+			for (int i = 0; i < sides; ++i) {
+				PairsData* d = table.get(i, file);
+				d->sparseIndex = reinterpret_cast<const SparseEntry*>(data);
+				data += d->sparseIndexSize * sizeof(SparseEntry);
+			}
+		}
+		for (int file = 0; file <= maxFile; ++file) {
+			for (int i = 0; i < sides; ++i) {
+				PairsData* d = table.get(i, file);
+				d->blockLength = reinterpret_cast<const u16*>(data);
+				data += d->blockLengthSize * sizeof(u16);
+			}
+		}
+		for (int file = 0; file <= maxFile; ++file) {
+			for (int i = 0; i < sides; ++i) {
+				data = reinterpret_cast<const u8*>(((uintptr_t) data + 0x3f) & ~(uintptr_t) 0x3f);
+				PairsData* d = table.get(i, file);
+				d->data = data;
+				data += (size_t) d->numBlocks * d->blockSize;
+			}
+		}
+	}
+	
+	// Result of a capture or pawn move, as DTZ before the move
+	int dtzBeforeZeroing(Syzygy::WDL wdl)
+	{
+		return wdl == Syzygy::win ? 1 : wdl == Syzygy::cursedWin ? 101 :
+			wdl == Syzygy::blessedLoss ? -101 : wdl == Syzygy::loss ? -1 : 0;
+	}
+	
+	bool isZeroing(const ChessBoard& board, move_t move)
+	{
+		return board.capturedPiece(move) != nothing || (board.board_[move & mask_6bit] & mask_piecetype) == pawn;
+	}
+}
+
+class Syzygy::Tablebases
+{
+public:
+	std::vector<string> directories;
+	std::deque<Table> tables;
+	std::unordered_map<u64, std::pair<Table*, Table*>> index;	// Material key to WDL and DTZ table
+	int largest = 0;
+	mutable std::mutex mapMutex;
+	
+	void add(const string& name);
+	Table* find(const ChessBoard& board, TableType type) const;
+	bool mapped(Table& table) const;
+};
+
+void Syzygy::Tablebases::add(const string& name)
+{
+	// "KRPvKR": up to seven pieces, each side with exactly one king in front
+	size_t separator = name.find('v');
+	if (separator == string::npos || name.size() - 1 > MAX_PIECES) return;
+	int counts[2][7] = {};
+	for (size_t i = 0; i < name.size(); ++i) {
+		if (i == separator) continue;
+		const char* type = std::strchr("PNBRQK", name[i]);
+		if (!type || !*type) return;
+		counts[i > separator][type - "PNBRQK" + 1]++;
+	}
+	if (counts[0][6] != 1 || counts[1][6] != 1 || name[0] != 'K' || name[separator + 1] != 'K') return;
+	
+	u64 key = materialKey(counts);
+	if (index.count(key)) return;
+	std::swap(counts[0], counts[1]);
+	u64 key2 = materialKey(counts);
+	std::swap(counts[0], counts[1]);
+	
+	Table* tableTypes[2];
+	for (TableType type : { tableWDL, tableDTZ }) {
+		tables.emplace_back();
+		Table& table = tables.back();
+		table.type = type;
+		table.name = name;
+		table.key = key;
+		table.key2 = key2;
+		table.pieceCount = (int) name.size() - 1;
+		table.hasPawns = (counts[0][1] + counts[1][1] > 0);
+		table.hasUniquePieces = false;
+		for (int color = 0; color < 2; ++color) {
+			for (int piece = 1; piece < 6; ++piece) {
+				if (counts[color][piece] == 1) table.hasUniquePieces = true;
+			}
+		}
+		// With pawns on both sides, the side with less pawns leads
+		bool whiteLeads = !counts[1][1] || (counts[0][1] && counts[1][1] >= counts[0][1]);
+		table.pawnCount[0] = counts[whiteLeads ? 0 : 1][1];
+		table.pawnCount[1] = counts[whiteLeads ? 1 : 0][1];
+		tableTypes[type] = &table;
+	}
+	index[key] = index[key2] = { tableTypes[0], tableTypes[1] };
+	largest = std::max(largest, (int) name.size() - 1);
+}
+
+Table* Syzygy::Tablebases::find(const ChessBoard& board, TableType type) const
+{
+	auto it = index.find(materialKey(board));
+	if (it == index.end()) return nullptr;
+	return (type == tableWDL ? it->second.first : it->second.second);
+}
+
+// Files are mapped on their first probe. A missing or broken file stays
+// unmapped, which fails all probes of the table.
+bool Syzygy::Tablebases::mapped(Table& table) const
+{
+	if (table.ready.load(std::memory_order_acquire)) return table.address != nullptr;
+	
+	std::lock_guard<std::mutex> lock(mapMutex);
+	if (table.ready.load(std::memory_order_relaxed)) return table.address != nullptr;
+	
+	string file = table.name + (table.type == tableWDL ? ".rtbw" : ".rtbz");
+	for (const string& directory : directories) {
+		int fd = ::open((directory + "/" + file).c_str(), O_RDONLY);
+		if (fd < 0) continue;
+		
+		struct stat status;
+		bool valid = (fstat(fd, &status) == 0 && status.st_size >= 16 && status.st_size % 64 == 16);
+		void* data = (valid ? mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED);
+		::close(fd);
+		if (data == MAP_FAILED) continue;
+		
+		if (std::memcmp(data, table.type == tableWDL ? WDL_MAGIC : DTZ_MAGIC, 4) != 0) {
+			munmap(data, status.st_size);
+			continue;
+		}
+		madvise(data, status.st_size, MADV_RANDOM);
+		table.address = data;
+		table.mappedSize = status.st_size;
+		setup(table, static_cast<const u8*>(data) + 4);
+		break;
+	}
+	table.ready.store(true, std::memory_order_release);
+	return table.address != nullptr;
+}
+
+namespace
+{
+	int probeTable(const Syzygy::Tablebases& tablebases, ChessBoard& board, TableType type, Syzygy::WDL wdl, ProbeState& state)
+	{
+		if (Magic::count(board.occupied_) == 2) return Syzygy::draw;
+		Table* table = tablebases.find(board, type);
+		if (!table || !tablebases.mapped(*table)) {
+			state = probeFail;
+			return 0;
+		}
+		return probeTable(board, *table, wdl, state);
+	}
+	
+	// Tables may store any value for positions with a winning capture and a
+	// loss instead of a draw if there is a drawing capture, so the captures
+	// (and for DTZ the pawn moves) are probed as well. Positions with an en
+	// passant capture are not stored correctly either.
+	Syzygy::WDL search(const Syzygy::Tablebases& tablebases, ChessBoard& board, ProbeState& state, bool checkZeroingMoves)
+	{
+		Syzygy::WDL bestValue = Syzygy::loss;
+		std::vector<move_t> movelist;
+		board.generateMoves(movelist);
+		size_t moveCount = 0;
+		
+		for (move_t move : movelist) {
+			if (board.capturedPiece(move) == nothing && (!checkZeroingMoves || !isZeroing(board, move))) continue;
+			++moveCount;
+			board.doMove(move);
+			Syzygy::WDL value = (Syzygy::WDL) -search(tablebases, board, state, false);
+			board.undoMove(move);
+			if (state == probeFail) return Syzygy::draw;
+			if (value > bestValue) {
+				bestValue = value;
+				if (value >= Syzygy::win) {
+					state = probeZeroingBestMove;
+					return value;
+				}
+			}
+		}
+		
+		// All moves are captures: The stored value may be wrong
+		bool noMoreMoves = (moveCount > 0 && moveCount == movelist.size());
+		Syzygy::WDL value = bestValue;
+		if (!noMoreMoves) {
+			value = (Syzygy::WDL) probeTable(tablebases, board, tableWDL, Syzygy::draw, state);
+			if (state == probeFail) return Syzygy::draw;
+		}
+		
+		if (bestValue >= value) {
+			state = (bestValue > Syzygy::draw || noMoreMoves ? probeZeroingBestMove : probeOk);
+			return bestValue;
+		}
+		state = probeOk;
+		return value;
+	}
+	
+	Syzygy::WDL probeWDL(const Syzygy::Tablebases& tablebases, ChessBoard& board, ProbeState& state)
+	{
+		state = probeOk;
+		return search(tablebases, board, state, false);
+	}
+	
+	bool hasLegalMoves(ChessBoard& board)
+	{
+		std::vector<move_t> movelist;
+		board.generateMoves(movelist);
+		return !movelist.empty();
+	}
+	
+	// Distance to zeroing in plies, may be one ply too long (see Syzygy::probeDTZ).
+	// DTZ tables store any value for positions where a capture or pawn move
+	// wins, so those moves are searched first.
+	int probeDTZ(const Syzygy::Tablebases& tablebases, ChessBoard& board, ProbeState& state)
+	{
+		state = probeOk;
+		Syzygy::WDL wdl = search(tablebases, board, state, true);
+		if (state == probeFail || wdl == Syzygy::draw) return 0;
+		if (state == probeZeroingBestMove) return dtzBeforeZeroing(wdl);
+		
+		int dtz = probeTable(tablebases, board, tableDTZ, wdl, state);
+		if (state == probeFail) return 0;
+		if (state != probeChangeSTM) {
+			return (dtz + 100 * (wdl == Syzygy::blessedLoss || wdl == Syzygy::cursedWin)) * signOf(wdl);
+		}
+		
+		// The table only stores the other side to move: Take the best move
+		int minDTZ = 0xffff;
+		std::vector<move_t> movelist;
+		board.generateMoves(movelist);
+		for (move_t move : movelist) {
+			bool zeroing = isZeroing(board, move);
+			board.doMove(move);
+			if (zeroing) {
+				dtz = -dtzBeforeZeroing(search(tablebases, board, state, false));
+			} else {
+				dtz = -probeDTZ(tablebases, board, state);
+			}
+			if (dtz == 1 && board.isKingAttacked(board.player_) && !hasLegalMoves(board)) minDTZ = 1;
+			if (!zeroing) dtz += signOf(dtz);
+			if (dtz < minDTZ && signOf(dtz) == signOf(wdl)) minDTZ = dtz;
+			board.undoMove(move);
+			if (state == probeFail) return 0;
+		}
+		return minDTZ == 0xffff ? -1 : minDTZ;
+	}
+	
+	// Ranks by DTZ: Wins that are certain within the 50-move rule rank
+	// equally, closer wins rank higher once the rule comes into sight
+	bool rankByDTZ(const Syzygy::Tablebases& tablebases, ChessBoard& board, const std::vector<move_t>& movelist,
+		std::vector<int>& ranks)
+	{
+		int drawmoves = board.drawmoves_;
+		ProbeState state;
+		for (size_t i = 0; i < movelist.size(); ++i) {
+			board.doMove(movelist[i]);
+			int dtz;
+			if (board.drawmoves_ == 0) {
+				dtz = dtzBeforeZeroing((Syzygy::WDL) -probeWDL(tablebases, board, state));
+			} else {
+				dtz = -probeDTZ(tablebases, board, state);
+				dtz = (dtz > 0 ? dtz + 1 : dtz < 0 ? dtz - 1 : dtz);
+			}
+			if (dtz == 2 && board.isKingAttacked(board.player_) && !hasLegalMoves(board)) dtz = 1;
+			board.undoMove(movelist[i]);
+			if (state == probeFail) return false;
+			
+			ranks[i] = (dtz > 0 ? (dtz + drawmoves <= 99 ? 1000 : 1000 - (dtz + drawmoves)) :
+				dtz < 0 ? (-dtz * 2 + drawmoves < 100 ? -1000 : -1000 + (-dtz + drawmoves)) : 0);
+		}
+		return true;
+	}
+	
+	// Fallback without DTZ tables
+	bool rankByWDL(const Syzygy::Tablebases& tablebases, ChessBoard& board, const std::vector<move_t>& movelist,
+		std::vector<int>& ranks)
+	{
+		static const int wdlRank[] = { -1000, -899, 0, 899, 1000 };
+		ProbeState state;
+		for (size_t i = 0; i < movelist.size(); ++i) {
+			board.doMove(movelist[i]);
+			Syzygy::WDL wdl = (Syzygy::WDL) -probeWDL(tablebases, board, state);
+			board.undoMove(movelist[i]);
+			if (state == probeFail) return false;
+			ranks[i] = wdlRank[wdl + 2];
+		}
+		return true;
+	}
+}
+
+std::shared_ptr<const Syzygy::Tablebases> Syzygy::load(const string& path)
+{
+	static std::mutex cacheMutex;
+	static std::map<string, std::weak_ptr<const Tablebases>> cache;
+	static bool initialized = false;
+	
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	auto cached = cache[path].lock();
+	if (cached) return cached;
+	
+	if (!initialized) {
+		initIndexing();
+		initialized = true;
+	}
+	
+	auto tablebases = std::make_shared<Tablebases>();
+	size_t start = 0;
+	while (start <= path.size()) {
+		size_t end = std::min(path.find(':', start), path.size());
+		string directory = path.substr(start, end - start);
+		start = end + 1;
+		if (directory.empty()) continue;
+		
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+			if (entry.path().extension() != ".rtbw") continue;
+			tablebases->add(entry.path().stem().string());
+		}
+		tablebases->directories.push_back(directory);
+	}
+	if (tablebases->tables.empty()) return nullptr;
+	
+	cache[path] = tablebases;
+	return tablebases;
+}
+
+int Syzygy::largest(const Tablebases& tablebases)
+{
+	return tablebases.largest;
+}
+
+bool Syzygy::probeWDL(const Tablebases& tablebases, ChessBoard& board, WDL& wdl)
+{
+	if (board.castling_ || Magic::count(board.occupied_) > tablebases.largest) return false;
+	ProbeState state;
+	wdl = ::probeWDL(tablebases, board, state);
+	return state != probeFail;
+}
+
+// n < -100: blessed loss, -100 <= n < -1: loss in n plies, -1: mated, 0: draw,
+// 1 < n <= 100: win in n plies, n > 100: cursed win. The distance may be one
+// ply too long, except for tables with positions right at the 50-move limit.
+bool Syzygy::probeDTZ(const Tablebases& tablebases, ChessBoard& board, int& dtz)
+{
+	if (board.castling_ || Magic::count(board.occupied_) > tablebases.largest) return false;
+	ProbeState state;
+	dtz = ::probeDTZ(tablebases, board, state);
+	return state != probeFail;
+}
+
+bool Syzygy::filterRootMoves(const Tablebases& tablebases, ChessBoard& board, std::vector<move_t>& movelist,
+	WDL& wdl, bool& usedDTZ)
+{
+	if (movelist.empty() || board.castling_ || Magic::count(board.occupied_) > tablebases.largest) return false;
+	
+	std::vector<int> ranks(movelist.size());
+	usedDTZ = rankByDTZ(tablebases, board, movelist, ranks);
+	if (!usedDTZ && !rankByWDL(tablebases, board, movelist, ranks)) return false;
+	
+	int best = *std::max_element(ranks.begin(), ranks.end());
+	std::vector<move_t> kept;
+	for (size_t i = 0; i < movelist.size(); ++i) {
+		if (ranks[i] == best) kept.push_back(movelist[i]);
+	}
+	movelist.swap(kept);
+	
+	// Ranks of 900 and more are wins within the 50-move rule
+	wdl = (best >= 900 ? win : best > 0 ? cursedWin : best == 0 ? draw : best > -900 ? blessedLoss : loss);
+	return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "types.hpp"
+
+// Forward declarations
+class ChessBoard;
+
+// Syzygy endgame tablebases
+//
+// WDL tables (.rtbw) give the game theoretical result of a position, DTZ
+// tables (.rtbz) the distance to the next capture or pawn move of the best
+// line. Files are memory-mapped on their first probe. Tables only exist for
+// positions without castling rights.
+namespace Syzygy
+{
+	// Results for the moving player; cursed wins and blessed losses are draws
+	// by the 50-move rule
+	enum WDL {
+		loss = -2,
+		blessedLoss = -1,
+		draw = 0,
+		cursedWin = 1,
+		win = 2
+	};
+
+	class Tablebases;
+
+	// Finds the tables in the directories of path (separated by ':'). Like
+	// networks, tablebases are cached by path and shared between engines.
+	// Returns nullptr if no table was found.
+	std::shared_ptr<const Tablebases> load(const std::string& path);
+
+	// Most pieces of a position that can be probed
+	int largest(const Tablebases& tablebases);
+
+	// Probes return false if a table is missing or the position has castling rights
+	bool probeWDL(const Tablebases& tablebases, ChessBoard& board, WDL& wdl);
+
+	// Distance in plies to a capture or pawn move; positive if winning
+	bool probeDTZ(const Tablebases& tablebases, ChessBoard& board, int& dtz);
+
+	// Keeps the root moves with the best tablebase result, ranked by DTZ if
+	// available and by WDL otherwise. The result is returned as wdl.
+	bool filterRootMoves(const Tablebases& tablebases, ChessBoard& board, std::vector<move_t>& movelist,
+		WDL& wdl, bool& usedDTZ);
+}
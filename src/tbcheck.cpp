@@ -0,0 +1,162 @@
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "bitbases.hpp"
+#include "chessboard.hpp"
+#include "syzygy.hpp"
+#include "tbcheck.hpp"
+#include "uci.hpp"
+
+// Mismatching positions reported per endgame
+#define REPORT_POSITIONS 5
+
+using std::string;
+using namespace ChessBoardConstants;
+
+namespace
+{
+	const char* names[] = { "KQK", "KRK", "KBNK", "KPK" };
+	const std::vector<piece_t> strongPieces[] = { { queen }, { rook }, { bishop, knight }, { pawn } };
+	
+	string fen(const ChessBoard& board)
+	{
+		static const char letters[] = " pnkxbrq";
+		string result;
+		for (int rank = 7; rank >= 0; --rank) {
+			int empty = 0;
+			for (int file = 0; file < 8; ++file) {
+				piece_t piece = board.board_[rank * 8 + file];
+				if (piece == nothing) {
+					++empty;
+					continue;
+				}
+				if (empty) result += (char)('0' + empty);
+				empty = 0;
+				char letter = letters[piece & mask_piecetype];
+				result += ((piece & mask_color) == white ? (char)(letter - 'a' + 'A') : letter);
+			}
+			if (empty) result += (char)('0' + empty);
+			if (rank) result += '/';
+		}
+		return result + (board.player_ == white ? " w - - 0 1" : " b - - 0 1");
+	}
+	
+	// Random legal position with a random strong side; false if the squares overlap
+	bool randomPosition(ChessBoard& board, Bitbases::Endgame endgame, std::mt19937_64& random)
+	{
+		player_t strong = (random() & 1 ? black : white);
+		square_t squares[4];
+		piece_t pieces[4] = { (piece_t)(strong | king), (piece_t)((strong ^ opponent) | king) };
+		int count = 2;
+		for (piece_t piece : strongPieces[endgame]) pieces[count++] = strong | piece;
+		for (int i = 0; i < count; ++i) {
+			squares[i] = random() % 64;
+			if ((pieces[i] & mask_piecetype) == pawn && (squares[i] < 8 || squares[i] >= 56)) return false;
+			for (int j = 0; j < i; ++j) {
+				if (squares[i] == squares[j]) return false;
+			}
+		}
+		board.setPieces(squares, pieces, count, random() & 1 ? black : white);
+		return !board.isKingAttacked(board.player_ ^ opponent);
+	}
+	
+	int sign(int value)
+	{
+		return (value > 0) - (value < 0);
+	}
+	
+	// DTZ that follows from the moves, 0 if none does
+	int knownDTZ(ChessBoard& board, const Bitbases& bitbases)
+	{
+		std::vector<move_t> movelist;
+		board.generateMoves(movelist);
+		if (movelist.empty()) return board.isKingAttacked(board.player_) ? -1 : 0;
+		
+		int dtz = 0;
+		for (move_t move : movelist) {
+			bool pawnMove = (board.board_[move & mask_6bit] & mask_piecetype) == pawn;
+			board.doMove(move);
+			std::vector<move_t> replies;
+			board.generateMoves(replies);
+			int result;
+			if (replies.empty() && board.isKingAttacked(board.player_)) {
+				dtz = 1;
+			} else if (pawnMove && bitbases.probe(board, result) && result < 0) {
+				dtz = 1;
+			}
+			board.undoMove(move);
+			if (dtz) break;
+		}
+		return dtz;
+	}
+}
+
+void TablebaseCheck::run(const Settings& settings)
+{
+	auto tablebases = Syzygy::load(settings.syzygyPath);
+	auto bitbases = Bitbases::load(settings.bitbasePath);
+	if (!tablebases || !bitbases) {
+		UCIProtocol::sendMessage("info string error: " + string(!tablebases ? "no tablebases in " + settings.syzygyPath :
+			"no bitbases in " + settings.bitbasePath));
+		return;
+	}
+	
+	std::mt19937_64 random(settings.seed);
+	ChessBoard board;
+	u64 totalProbed = 0, totalErrors = 0;
+	for (int e = 0; e < Bitbases::endgames; ++e) {
+		Bitbases::Endgame endgame = (Bitbases::Endgame) e;
+		if (!bitbases->has(endgame)) {
+			UCIProtocol::sendMessage(string("info string tbcheck ") + names[e] + " skipped: no bitbase");
+			continue;
+		}
+		
+		u64 probed = 0, known = 0, errors = 0;
+		for (u64 i = 0; i < settings.positions; ++i) {
+			while (!randomPosition(board, endgame, random));
+			
+			int expected;
+			Syzygy::WDL wdl;
+			int dtz;
+			if (!bitbases->probe(board, expected)) continue;
+			if (!Syzygy::probeWDL(*tablebases, board, wdl) || !Syzygy::probeDTZ(*tablebases, board, dtz)) {
+				// Missing tables fail on the first probe
+				if (!probed) break;
+				++errors;
+				continue;
+			}
+			++probed;
+			
+			int dtzExpected = knownDTZ(board, *bitbases);
+			if (dtzExpected) ++known;
+			
+			// Cursed wins and blessed losses are wins and losses without the 50-move rule
+			bool wrong = sign(wdl) != expected || sign(dtz) != sign(wdl) || (dtzExpected && dtz != dtzExpected);
+			if (!wrong) continue;
+			if (++errors <= REPORT_POSITIONS) {
+				std::stringstream ss;
+				ss << "info string tbcheck " << names[e] << " mismatch " << fen(board) << " bitbase " << expected;
+				ss << " wdl " << wdl << " dtz " << dtz;
+				if (dtzExpected) ss << " expected dtz " << dtzExpected;
+				UCIProtocol::sendMessage(ss.str());
+			}
+		}
+		totalProbed += probed;
+		totalErrors += errors;
+		
+		std::stringstream ss;
+		ss << "info string tbcheck " << names[e];
+		if (!probed) {
+			ss << " skipped: no table";
+		} else {
+			ss << " positions " << probed << " known dtz " << known << " mismatches " << errors;
+		}
+		UCIProtocol::sendMessage(ss.str());
+	}
+	if (!totalProbed) {
+		UCIProtocol::sendMessage("info string error: no table could be checked");
+	} else {
+		UCIProtocol::sendMessage(string("info string tbcheck ") + (totalErrors ? "failed" : "passed"));
+	}
+}
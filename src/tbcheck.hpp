@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include "types.hpp"
+
+// Checks Syzygy tables against results that do not depend on them
+//
+// Random positions of KQK, KRK, KBNK and KPK are probed. The WDL result has
+// to match the retrograde bitbases (see Bitbases), the DTZ sign the WDL
+// result. DTZ values follow from the moves in three cases: -1 if the side to
+// move is mated, 1 if it mates in one and, in KPK, 1 if a pawn move wins.
+class TablebaseCheck
+{
+public:
+	struct Settings {
+		std::string syzygyPath;
+		std::string bitbasePath = ".";
+		u64 positions = 100000;		// per endgame
+		u64 seed = 1;
+	};
+	
+	static void run(const Settings& settings);
+
+private:
+	TablebaseCheck() = delete;
+
+};
@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "engine.hpp"
+#include "testsuite.hpp"
+#include "uci.hpp"
+
+// Search time if no limit is given
+#define DEFAULT_MOVETIME 1000
+
+using std::string;
+using namespace std::chrono;
+
+namespace
+{
+	struct TestPosition
+	{
+		string fen;
+		string id;
+		std::vector<string> bestMoves;
+		std::vector<string> avoidMoves;
+	};
+	
+	struct TestResult
+	{
+		bool valid = false;
+		bool solved = false;
+		string move;
+		int depth = 0;
+		u64 nodes = 0;
+		int time = 0;
+		u64 solveNodes = 0;
+		int solveTime = 0;
+	};
+	
+	string trim(const string& s)
+	{
+		size_t begin = s.find_first_not_of(" \t\r");
+		if (begin == string::npos) return "";
+		return s.substr(begin, s.find_last_not_of(" \t\r") - begin + 1);
+	}
+	
+	// EPD: four FEN fields followed by operations "opcode operands;"
+	bool parseEPD(const string& line, TestPosition& position)
+	{
+		std::istringstream in(line);
+		string fields[4];
+		for (string& field : fields) {
+			if (!(in >> field)) return false;
+		}
+		position.fen = fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3];
+		
+		string operations;
+		std::getline(in, operations);
+		std::istringstream ops(operations);
+		string operation;
+		while (std::getline(ops, operation, ';')) {
+			operation = trim(operation);
+			size_t space = operation.find(' ');
+			if (space == string::npos) continue;
+			string opcode = operation.substr(0, space);
+			string operands = trim(operation.substr(space + 1));
+			if (opcode == "id") {
+				operands.erase(std::remove(operands.begin(), operands.end(), '"'), operands.end());
+				position.id = operands;
+			} else if (opcode == "bm" || opcode == "am") {
+				std::istringstream moves(operands);
+				std::vector<string>& target = (opcode == "bm" ? position.bestMoves : position.avoidMoves);
+				for (string move; moves >> move;) target.push_back(move);
+			}
+		}
+		return true;
+	}
+	
+	bool containsMove(ChessBoard& board, const std::vector<string>& moves, move_t move)
+	{
+		for (const string& name : moves) {
+			if ((board.parseSAN(name) & 0xffff) == (move & 0xffff)) return true;
+		}
+		return false;
+	}
+	
+	bool isSolution(ChessBoard& board, const TestPosition& position, move_t move)
+	{
+		if (!position.bestMoves.empty() && !containsMove(board, position.bestMoves, move)) return false;
+		return !containsMove(board, position.avoidMoves, move);
+	}
+	
+	string joinMoves(const std::vector<string>& moves)
+	{
+		string result;
+		for (const string& move : moves) result += (result.empty() ? "" : " ") + move;
+		return result;
+	}
+	
+	// Quotes for CSV and JSON; ids of test suites contain no quotes
+	string quote(const string& s)
+	{
+		return "\"" + s + "\"";
+	}
+}
+
+void TestSuite::run(const Settings& settings)
+{
+	std::ifstream in(settings.file);
+	if (!in) {
+		UCIProtocol::sendMessage("info string error: cannot open " + settings.file);
+		return;
+	}
+	std::vector<TestPosition> positions;
+	for (string line; std::getline(in, line);) {
+		TestPosition position;
+		if (trim(line).empty() || !parseEPD(line, position)) continue;
+		if (position.id.empty()) position.id = std::to_string(positions.size() + 1);
+		positions.push_back(position);
+	}
+	
+	SearchLimits limits;
+	limits.depth = settings.depth;
+	limits.nodes = settings.nodes;
+	limits.movetime = settings.movetime;
+	if (!limits.depth && !limits.nodes && !limits.movetime) limits.movetime = DEFAULT_MOVETIME;
+	
+	std::vector<TestResult> results(positions.size());
+	std::atomic<size_t> next(0);
+	auto startTime = steady_clock::now();
+	
+	auto worker = [&]() {
+		Engine engine(settings.hashSize, true);
+		for (auto& option : settings.options) engine.setOption(option.first, option.second);
+		ChessBoard& board = engine.board();
+		
+		for (size_t i = next++; i < positions.size(); i = next++) {
+			const TestPosition& position = positions[i];
+			TestResult& result = results[i];
+			engine.newGame();
+			if (!board.setFEN(position.fen)) continue;
+			
+			engine.Search(limits);
+			move_t move = engine.bestMove();
+			if (move == 0) continue;
+			result.valid = true;
+			result.move = board.sanMove(move);
+			result.solved = isSolution(board, position, move);
+			result.nodes = engine.nodesSearched();
+			
+			// The solution was found by the first iteration of the final run of correct moves
+			const std::vector<Engine::Iteration>& iterations = engine.iterations();
+			if (!iterations.empty()) {
+				result.depth = iterations.back().depth;
+				result.time = iterations.back().time;
+			}
+			for (size_t k = iterations.size(); result.solved && k > 0 && isSolution(board, position, iterations[k - 1].move); --k) {
+				result.solveNodes = iterations[k - 1].nodes;
+				result.solveTime = iterations[k - 1].time;
+			}
+		}
+	};
+	
+	std::vector<std::thread> threads;
+	for (int i = 1; i < settings.threads; ++i) threads.emplace_back(worker);
+	worker();
+	for (std::thread& thread : threads) thread.join();
+	
+	auto milli = duration_cast<milliseconds>(steady_clock::now() - startTime).count();
+	size_t solved = 0, scored = 0;
+	u64 solveTime = 0;
+	for (size_t i = 0; i < positions.size(); ++i) {
+		if (positions[i].bestMoves.empty() && positions[i].avoidMoves.empty()) continue;
+		++scored;
+		if (results[i].solved) {
+			++solved;
+			solveTime += results[i].solveTime;
+		}
+	}
+	
+	std::stringstream ss;
+	if (settings.json) {
+		ss << "{\"file\":" << quote(settings.file) << ",\"positions\":" << positions.size();
+		ss << ",\"scored\":" << scored << ",\"solved\":" << solved << ",\"time_ms\":" << milli << ",\"results\":[";
+		for (size_t i = 0; i < positions.size(); ++i) {
+			const TestResult& r = results[i];
+			ss << (i ? "," : "") << "{\"id\":" << quote(positions[i].id);
+			ss << ",\"bm\":" << quote(joinMoves(positions[i].bestMoves)) << ",\"am\":" << quote(joinMoves(positions[i].avoidMoves));
+			ss << ",\"move\":" << quote(r.move) << ",\"solved\":" << (r.solved ? "true" : "false");
+			ss << ",\"depth\":" << r.depth << ",\"nodes\":" << r.nodes << ",\"time_ms\":" << r.time;
+			ss << ",\"solve_nodes\":" << r.solveNodes << ",\"solve_time_ms\":" << r.solveTime << "}";
+		}
+		ss << "]}";
+	} else {
+		ss << "id,bm,am,move,solved,depth,nodes,time_ms,solve_nodes,solve_time_ms";
+		for (size_t i = 0; i < positions.size(); ++i) {
+			const TestResult& r = results[i];
+			ss << "\n" << quote(positions[i].id) << "," << joinMoves(positions[i].bestMoves) << ",";
+			ss << joinMoves(positions[i].avoidMoves) << "," << (r.valid ? r.move : "none") << ",";
+			ss << (r.solved ? 1 : 0) << "," << r.depth << "," << r.nodes << "," << r.time << ",";
+			ss << r.solveNodes << "," << r.solveTime;
+		}
+	}
+	UCIProtocol::sendMessage(ss.str());
+	
+	// The summary stays out of the CSV rows
+	if (!settings.json) {
+		std::stringstream summary;
+		summary << "info string epd solved " << solved << "/" << scored;
+		summary << " avg_solve_ms " << (solved ? solveTime / solved : 0) << " time_ms " << milli;
+		UCIProtocol::sendMessage(summary.str());
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "types.hpp"
+
+// Runs the positions of an EPD test suite (WAC, STS, ...) and checks the best
+// move against the "bm" (best move) and "am" (avoid move) operations
+//
+// Every thread searches positions with its own engine. For solved positions
+// the time and the nodes to the solution are taken from the first iteration
+// after which the best move did not change to a wrong move anymore.
+class TestSuite
+{
+public:
+	struct Settings {
+		std::string file;
+		int depth = 0;
+		u64 nodes = 0;
+		int movetime = 0;		// Milliseconds per position; the default if no limit is given
+		int threads = 1;
+		int hashSize = 16;		// in megabytes, per thread
+		bool json = false;		// CSV otherwise
+		std::vector<std::pair<std::string, std::string>> options;	// applied to every engine
+	};
+	
+	static void run(const Settings& settings);
+
+private:
+	TestSuite() = delete;
+
+};
@@ -0,0 +1,104 @@
+#include <algorithm>
+
+#include "chessboard.hpp"
+#include "timemanager.hpp"
+
+// Time reserved for communication with the GUI, in milliseconds
+#define MOVE_OVERHEAD 30
+// Number of remaining moves assumed in sudden death time controls
+#define MOVES_TO_GO_DEFAULT 30
+// Score drop in centipawns that counts as a worsening position
+#define SCORE_DROP 30
+// Number of iterations with the same best move that count as stable
+#define STABLE_ITERATIONS 4
+// Maximum factor between hard and soft limit
+#define HARD_LIMIT_FACTOR 3
+// Time per move in milliseconds when the clock of the player to move is
+// missing or empty
+#define MINIMUM_TIME 10
+
+using namespace std::chrono;
+using namespace ChessBoardConstants;
+
+void TimeManager::start(const SearchLimits& limits, player_t player)
+{
+	startTime_ = steady_clock::now();
+	softLimit_ = 0;
+	hardLimit_ = 0;
+	fixedTime_ = false;
+	iterations_ = 0;
+	stableIterations_ = 0;
+	bestMoveChanges_ = 0;
+	previousBestMove_ = 0;
+	previousScore_ = 0;
+	
+	if (limits.infinite) return;
+	
+	// Fixed time per move: use all of it
+	if (limits.movetime > 0) {
+		fixedTime_ = true;
+		softLimit_ = hardLimit_ = std::max(1, limits.movetime - MOVE_OVERHEAD);
+		return;
+	}
+	
+	int time = (player == white ? limits.wtime : limits.btime);
+	int increment = (player == white ? limits.winc : limits.binc);
+	if (!limits.clock) return;
+	
+	// A clock without time for the player to move does not allow an unlimited search
+	if (time <= 0 && increment <= 0) {
+		fixedTime_ = true;
+		softLimit_ = hardLimit_ = MINIMUM_TIME;
+		return;
+	}
+	
+	// Spread the remaining time evenly over the remaining moves and spend most
+	// of the increment. Never use more than half of the clock on a single move,
+	// unless it is the last move before the time control.
+	int movesToGo = (limits.movestogo > 0 ? std::min(limits.movestogo, MOVES_TO_GO_DEFAULT) : MOVES_TO_GO_DEFAULT);
+	int available = std::max(1, time - MOVE_OVERHEAD);
+	int maximum = available * (movesToGo == 1 ? 9 : 5) / 10;
+	
+	softLimit_ = available / movesToGo + increment * 3 / 4;
+	hardLimit_ = std::max(1, std::min(maximum, softLimit_ * HARD_LIMIT_FACTOR));
+	softLimit_ = std::max(1, std::min(softLimit_, hardLimit_));
+}
+
+void TimeManager::restart()
+{
+	startTime_ = steady_clock::now();
+}
+
+int TimeManager::elapsed() const
+{
+	return (int) duration_cast<milliseconds>(steady_clock::now() - startTime_).count();
+}
+
+bool TimeManager::continueSearch(move_t bestmove, score_t score)
+{
+	int time = elapsed();
+	if (softLimit_ == 0) return true;
+	if (fixedTime_) return time < hardLimit_;
+	
+	// Track how often the best move changed, older changes count less
+	bestMoveChanges_ /= 2;
+	if (iterations_ > 0 && bestmove != previousBestMove_) {
+		bestMoveChanges_ += 1.0f;
+		stableIterations_ = 0;
+	} else {
+		++stableIterations_;
+	}
+	
+	float scale = 1.0f + bestMoveChanges_;
+	if (iterations_ > 0 && score < previousScore_ - SCORE_DROP) scale *= 1.5f;
+	if (stableIterations_ >= STABLE_ITERATIONS) scale *= 0.6f;
+	
+	++iterations_;
+	previousBestMove_ = bestmove;
+	previousScore_ = score;
+	
+	// Each iteration takes about five times longer than the previous ones
+	// together, so only start another one while it can finish near the optimum
+	int optimum = std::min((float) hardLimit_, softLimit_ * scale);
+	return time < optimum * 2 / 5;
+}
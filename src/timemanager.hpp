@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include "types.hpp"
+
+// Limits for a single search as given by the "go" command
+// Zero means that a limit was not given
+struct SearchLimits
+{
+	int wtime = 0;		// Remaining clock time in milliseconds
+	int btime = 0;
+	int winc = 0;		// Increment per move in milliseconds
+	int binc = 0;
+	int movestogo = 0;	// Moves until the next time control
+	int movetime = 0;	// Exact search time in milliseconds
+	int depth = 0;		// Maximum search depth in plies
+	u64 nodes = 0;		// Maximum number of nodes
+	int mate = 0;		// Search for a mate in x moves
+	bool clock = false;	// One of wtime, btime, winc and binc was given
+	bool infinite = false;
+	bool ponder = false;	// Search the expected reply until "ponderhit" or "stop"
+};
+
+class TimeManager
+{
+public:
+	// Computes the time budget for the player to move
+	void start(const SearchLimits& limits, player_t player);
+	
+	// Restarts the clock with the same budget (after a ponder hit)
+	void restart();
+	
+	// Milliseconds since the search was started
+	int elapsed() const;
+	
+	// Polled during the search: the hard limit aborts the running iteration
+	bool hardLimitReached() const { return hardLimit_ > 0 && elapsed() >= hardLimit_; }
+	
+	// Called after each completed iteration: Decides whether another iteration
+	// should be started. An unstable best move or a dropping score extend the
+	// soft limit, a best move that stays the same shortens it.
+	bool continueSearch(move_t bestmove, score_t score);
+	
+	int softLimit() const { return softLimit_; }
+	int hardLimit() const { return hardLimit_; }
+
+private:
+	std::chrono::steady_clock::time_point startTime_;
+	int softLimit_ = 0;
+	int hardLimit_ = 0;
+	bool fixedTime_ = false;
+	
+	// Search stability
+	int iterations_ = 0;
+	int stableIterations_ = 0;
+	float bestMoveChanges_ = 0;
+	move_t previousBestMove_ = 0;
+	score_t previousScore_ = 0;
+
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <charconv>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include "types.hpp"
+
+// Splits a line into tokens separated by spaces, tabs and carriage returns.
+// Tokens are views into the line, which has to outlive them.
+class Tokens
+{
+public:
+	explicit Tokens(std::string_view line):line_(line) { skipSpace(); }
+	
+	bool empty() const { return line_.empty(); }
+	
+	// The next token; empty at the end of the line
+	std::string_view next()
+	{
+		size_t end = 0;
+		while (end < line_.size() && !isSpace(line_[end])) ++end;
+		std::string_view token = line_.substr(0, end);
+		line_.remove_prefix(end);
+		skipSpace();
+		return token;
+	}
+	
+	// The remaining text, starting at the next token
+	std::string_view rest() const { return line_; }
+	
+	// Numbers are parsed like atoi: Invalid input gives 0
+	static int toInt(std::string_view token)
+	{
+		if (!token.empty() && token[0] == '+') token.remove_prefix(1);
+		int value = 0;
+		std::from_chars(token.data(), token.data() + token.size(), value);
+		return value;
+	}
+	
+	static u64 toU64(std::string_view token)
+	{
+		if (!token.empty() && token[0] == '+') token.remove_prefix(1);
+		u64 value = 0;
+		std::from_chars(token.data(), token.data() + token.size(), value);
+		return value;
+	}
+	
+	static double toDouble(std::string_view token)
+	{
+		return std::atof(std::string(token).c_str());
+	}
+
+private:
+	static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+	
+	void skipSpace()
+	{
+		size_t start = 0;
+		while (start < line_.size() && isSpace(line_[start])) ++start;
+		line_.remove_prefix(start);
+	}
+	
+	std::string_view line_;
+
+};
@@ -1,51 +1,89 @@
-#include <iostream>
+#include <algorithm>
+#include <cstring>
 
 #include "data.hpp"
+#include "profiler.hpp"
 #include "score.hpp"
 #include "transpositiontable.hpp"
 
+// Searches after which an entry of equal depth is replaced
 #define AGE_DECAY 8
+// Generations wrap around within the 6 bits of the age
+#define AGE_MASK 63
 
-TranspositionTable::TranspositionTable(int maxSize)
+TranspositionTable::TranspositionTable(size_t maxSize)
 {
 	sizeMask_ = 1ULL << 32;
 	while (sizeMask_ * sizeof(HashEntry) > maxSize) sizeMask_ >>= 1;
 	
-	HashEntry empty;
+	HashEntry empty{};
 	empty.type = hashfEmpty;
 	table_.resize(sizeMask_, empty);
-	
-	std::cout << "Hash table initialized: " << sizeMask_ << " entries, ";
-	std::cout << ((sizeMask_ * sizeof(HashEntry)) / 1024) << "kb total size" << std::endl;
 	--sizeMask_;
 }
 
+// Resets the whole entries, as probing only compares the stored zobrist key
 void TranspositionTable::clear()
 {
-	for (HashEntry& entry : table_) entry.type = hashfEmpty;
+	HashEntry empty{};
+	empty.type = hashfEmpty;
+	std::fill(table_.begin(), table_.end(), empty);
+}
+
+// The data behind the key: value, move, depth and the byte of type and age
+u64 TranspositionTable::dataWord(const HashEntry& entry)
+{
+	u64 data = 0;
+	std::memcpy(&data, &entry.value, sizeof(HashEntry) - sizeof(entry.zobrist));
+	return data;
 }
 
-void TranspositionTable::recordHash(u64 zobrist,
+bool TranspositionTable::recordHash(u64 zobrist,
 									score_t value,
 									HashType type,
 									int depth,
-									int age,
 									move_t move)
 {
+	PROFILE_SCOPE(ttStore);
 	HashEntry& entry = table_[zobrist & sizeMask_];
+	u8 generation = generation_.load(std::memory_order_relaxed);
+	int age = (generation - entry.age) & AGE_MASK;
 	if (entry.type == hashfEmpty ||
 		depth >= entry.depth ||
-		depth + age >= entry.depth + entry.age + AGE_DECAY
+		depth + age >= entry.depth + AGE_DECAY
 	) {
-		entry.zobrist = zobrist;
-		entry.value = (u16) value;
-		entry.move = (u16) move;
-		entry.depth = (u8) depth;
-		entry.type = (u8) type;
+		HashEntry update = entry;
+		update.value = (u16) value;
+		update.move = (u16) move;
+		update.depth = (u8) depth;
+		update.type = (u8) type;
+		update.age = generation;
+		update.zobrist = zobrist ^ dataWord(update);
+		entry = update;
+		return true;
 	}
+	return false;
+}
+
+TranspositionTable::HashEntry TranspositionTable::getEntry(u64 zobrist) const
+{
+	PROFILE_SCOPE(ttProbe);
+	HashEntry entry = table_[zobrist & sizeMask_];
+	entry.zobrist ^= dataWord(entry);
+	return entry;
+}
+
+void TranspositionTable::newSearch()
+{
+	u8 generation = generation_.load(std::memory_order_relaxed);
+	generation_.store((generation + 1) & AGE_MASK, std::memory_order_relaxed);
 }
 
-const TranspositionTable::HashEntry& TranspositionTable::getEntry(u64 zobrist) const
+int TranspositionTable::hashfull() const
 {
-	return table_[zobrist & sizeMask_];
+	u8 generation = generation_.load(std::memory_order_relaxed);
+	size_t samples = std::min<size_t>(1000, table_.size());
+	size_t used = std::count_if(table_.begin(), table_.begin() + samples,
+		[generation](const HashEntry& entry) { return entry.type != hashfEmpty && entry.age == generation; });
+	return (int)(used * 1000 / samples);
 }
@@ -1,35 +1,50 @@
 #pragma once
 
+#include <atomic>
 #include <vector>
 #include "types.hpp"
 
+// Engines may share a table between threads. Entries are written without
+// locks: the stored key is xor-ed with the data, so that an entry torn by a
+// concurrent write does not match any position.
 class TranspositionTable
 {
 public:
 
 	#pragma pack(push, 1)
 	struct HashEntry {
-		u64 zobrist;
+		u64 zobrist;	// xor-ed with the data in the table
 		score_t value;
 		u16 move;
 		u8 depth;
-		u8 type;
-		u8 age;
+		u8 type : 2;
+		u8 age : 6;		// Search generation of the store
 	};
 	#pragma pack(pop)
+	static_assert(sizeof(HashEntry) == 14, "hash entries should be 14 bytes");
 	
 	enum HashType {
 		hashfEmpty, hashfExact, hashfAlpha, hashfBeta
 	};
 	
-	TranspositionTable(int maxSize);
-	void recordHash(u64 zobrist, score_t value, HashType type, int depth, int age, move_t move);
-	const HashEntry& getEntry(u64 zobrist) const;
+	TranspositionTable(size_t maxSize);
+	// False if the replacement scheme kept the old entry
+	bool recordHash(u64 zobrist, score_t value, HashType type, int depth, move_t move);
+	HashEntry getEntry(u64 zobrist) const;
 	void clear();
+	size_t size() const { return table_.size(); }
 	
+	// Starts a new search generation: Older entries are replaced first
+	void newSearch();
+	
+	// Entries of the current generation in permille, sampled from the start of the table
+	int hashfull() const;
+
 private:
+	static u64 dataWord(const HashEntry& entry);
 	
 	size_t sizeMask_;
 	std::vector<HashEntry> table_;
-	
+	std::atomic<u8> generation_{0};	// Advanced by every engine that uses the table
+
 };
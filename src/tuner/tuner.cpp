@@ -0,0 +1,336 @@
+// Texel tuner for the evaluation parameters in score.hpp
+//
+// Usage: tuner <dataset> [-t threads] [-n positions] [-i iterations] [-k scale] [-o output]
+//
+// The dataset contains one labelled quiet position per line: a FEN or EPD
+// record followed by the game result, e.g.
+//   rnbqkb1r/pp2pppp/5n2/2pp4/3P4/2P2N2/PP2PPPP/RNBQKB1R w KQkq - c9 "1/2-1/2";
+//   8/5k2/8/3K4/8/8/5P2/8 b - - 0 52 [1.0]
+// Results are always from white's point of view.
+//
+// The tuner minimizes the mean squared error between the results and the
+// evaluations mapped to a winning probability. It is compiled together with
+// the engine sources (without main.cpp) and TUNING defined, so that the
+// tables in score.hpp become modifiable.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../chessboard.hpp"
+#include "../evaluator.hpp"
+#include "../score.hpp"
+
+#ifndef TUNING
+#error "The tuner has to be compiled with TUNING defined"
+#endif
+
+#define STEP 10		// Millipawns, one centipawn of evaluation
+#define TABLE_COLUMNS 8
+// ln(10) / 400: the winning probability is 1 / (1 + 10^(-k * eval / 400))
+#define LN10_400 0.005756462732485115
+
+using std::string;
+using namespace ChessBoardConstants;
+using namespace std::chrono;
+
+namespace
+{
+	// Positions are stored compactly: the occupancy and the pieces in square order
+	struct Position
+	{
+		bitboard_t occupied;
+		u8 pieces[16];		// Two 4 bit pieces per byte
+		u8 player;
+		float result;
+	};
+	
+	// A single value of a table; the mirror is kept at the negated value
+	struct Parameter
+	{
+		score_t* value;
+		score_t* mirror;
+	};
+	
+	// Tables are written back in the layout of score.hpp
+	struct Table
+	{
+		const char* name;
+		score_t* values;
+		int count;
+	};
+	
+	const std::vector<Table> tables = {
+		{ "pieces", Score::pieces, 16 },
+		{ "pawn_squares", Score::pawn_squares, 64 },
+		{ "knight_squares", Score::knight_squares, 64 },
+		{ "bishop_squares", Score::bishop_squares, 64 },
+		{ "queen_squares", Score::queen_squares, 64 },
+		{ "king_squares_midgame", Score::king_squares_midgame, 64 },
+		{ "king_squares_endgame", Score::king_squares_endgame, 64 },
+	};
+	
+	std::vector<Parameter> collectParameters()
+	{
+		std::vector<Parameter> parameters;
+		for (piece_t type : { pawn, knight, bishop, rook, queen }) {
+			parameters.push_back({ &Score::pieces[white | type], &Score::pieces[black | type] });
+		}
+		for (const Table& table : tables) {
+			if (table.values == Score::pieces) continue;
+			for (int i = 0; i < table.count; ++i) {
+				// Pawns never stand on the first or last rank
+				if (table.values == Score::pawn_squares && (i < 8 || i >= 56)) continue;
+				parameters.push_back({ &table.values[i], nullptr });
+			}
+		}
+		return parameters;
+	}
+	
+	void setParameter(const Parameter& parameter, int value)
+	{
+		*parameter.value = (score_t) value;
+		if (parameter.mirror) *parameter.mirror = (score_t) -value;
+	}
+	
+	bool parseResult(const string& line, float& result)
+	{
+		if (line.find("1/2-1/2") != string::npos) {
+			result = 0.5f;
+		} else if (line.find("1-0") != string::npos) {
+			result = 1.0f;
+		} else if (line.find("0-1") != string::npos) {
+			result = 0.0f;
+		} else {
+			size_t open = line.rfind('[');
+			if (open == string::npos) return false;
+			result = (float) std::atof(line.c_str() + open + 1);
+		}
+		return true;
+	}
+	
+	bool encode(const ChessBoard& board, float result, Position& position)
+	{
+		position = Position();
+		position.occupied = board.occupied_;
+		position.player = (u8) board.player_;
+		position.result = result;
+		
+		bitboard_t pieces = board.occupied_;
+		for (int i = 0; pieces; ++i) {
+			if (i == 32) return false;
+			square_t square = Magic::extractBit(pieces);
+			position.pieces[i / 2] |= board.board_[square] << ((i & 1) * 4);
+		}
+		return true;
+	}
+	
+	// Only fills what the evaluator reads
+	void decode(const Position& position, ChessBoard& board)
+	{
+		std::fill_n(board.mask_, 16, 0);
+		std::fill_n(board.board_, 64, 0);
+		board.occupied_ = position.occupied;
+		board.player_ = position.player;
+		
+		bitboard_t pieces = position.occupied;
+		for (int i = 0; pieces; ++i) {
+			square_t square = Magic::extractBit(pieces);
+			piece_t piece = (position.pieces[i / 2] >> ((i & 1) * 4)) & mask_4bit;
+			board.board_[square] = piece;
+			board.mask_[piece] |= BIT(square);
+			board.mask_[piece & mask_color] |= BIT(square);
+		}
+	}
+	
+	std::vector<Position> loadDataset(const string& path, size_t maxPositions)
+	{
+		std::vector<Position> positions;
+		std::ifstream in(path);
+		if (!in) return positions;
+		
+		ChessBoard board;
+		string line;
+		size_t invalid = 0;
+		while (positions.size() < maxPositions && std::getline(in, line)) {
+			if (line.empty()) continue;
+			Position position;
+			float result;
+			if (!parseResult(line, result) || !board.setFEN(line) || !encode(board, result, position)) {
+				++invalid;
+				continue;
+			}
+			positions.push_back(position);
+		}
+		if (invalid > 0) std::cout << "Skipped " << invalid << " invalid lines" << std::endl;
+		return positions;
+	}
+	
+	class Tuner
+	{
+	public:
+		Tuner(const std::vector<Position>& positions, int threads)
+			: positions_(positions), threads_(threads) {}
+		
+		// Mean squared error of the predicted results, evaluated in parallel
+		double error(double k)
+		{
+			std::vector<double> sums(threads_, 0.0);
+			auto worker = [&](int index) {
+				ChessBoard board;
+				size_t begin = positions_.size() * index / threads_;
+				size_t end = positions_.size() * (index + 1) / threads_;
+				double sum = 0.0;
+				for (size_t i = begin; i < end; ++i) {
+					decode(positions_[i], board);
+					int eval = Evaluator::evaluatePosition(board);
+					if (board.player_ == black) eval = -eval;
+					double predicted = 1.0 / (1.0 + std::exp(-k * eval * LN10_400));
+					sum += (positions_[i].result - predicted) * (positions_[i].result - predicted);
+				}
+				sums[index] = sum;
+			};
+			
+			std::vector<std::thread> workers;
+			for (int i = 1; i < threads_; ++i) workers.emplace_back(worker, i);
+			worker(0);
+			for (std::thread& thread : workers) thread.join();
+			
+			evaluations_ += positions_.size();
+			double total = 0.0;
+			for (double sum : sums) total += sum;
+			return total / positions_.size();
+		}
+		
+		// Scaling constant of the sigmoid with the least error for the current parameters
+		double fitScale()
+		{
+			double best = 1.0;
+			double bestError = error(best);
+			for (double step : { 0.1, 0.01 }) {
+				double center = best;
+				for (int i = -10; i <= 10; ++i) {
+					double k = center + i * step;
+					if (k <= 0.0 || i == 0) continue;
+					double e = error(k);
+					if (e < bestError) {
+						bestError = e;
+						best = k;
+					}
+				}
+			}
+			return best;
+		}
+		
+		u64 evaluations() const { return evaluations_; }
+	
+	private:
+		const std::vector<Position>& positions_;
+		int threads_;
+		u64 evaluations_ = 0;
+	};
+	
+	void writeTables(const string& path)
+	{
+		std::ofstream out(path);
+		out << "// Tuned evaluation parameters, to replace the tables in score.hpp\n\n";
+		out << "namespace Score\n{\n";
+		for (const Table& table : tables) {
+			if (&table != &tables.front()) out << "\t\n";
+			if (table.count == 1) {
+				out << "\tTUNABLE score_t " << table.name << " = " << table.values[0] << ";\n";
+				continue;
+			}
+			out << "\tTUNABLE score_t " << table.name << "[] = {\n";
+			for (int i = 0; i < table.count; ++i) {
+				if (i % TABLE_COLUMNS == 0) out << "\t\t";
+				out << std::setw(5) << table.values[i] << (i + 1 < table.count ? "," : "");
+				out << ((i + 1) % TABLE_COLUMNS == 0 || i + 1 == table.count ? "\n" : " ");
+			}
+			out << "\t};\n";
+		}
+		out << "}\n";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		std::cout << "Usage: tuner <dataset> [-t threads] [-n positions] [-i iterations] [-k scale] [-o output]" << std::endl;
+		return 1;
+	}
+	
+	string dataset = argv[1];
+	string output = "tuned.hpp";
+	int threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t maxPositions = SIZE_MAX;
+	int iterations = 1000;
+	double k = 0.0;
+	for (int i = 2; i + 1 < argc; i += 2) {
+		string flag = argv[i];
+		if (flag == "-t") threads = std::max(1, std::atoi(argv[i + 1]));
+		else if (flag == "-n") maxPositions = std::strtoull(argv[i + 1], nullptr, 10);
+		else if (flag == "-i") iterations = std::atoi(argv[i + 1]);
+		else if (flag == "-k") k = std::atof(argv[i + 1]);
+		else if (flag == "-o") output = argv[i + 1];
+	}
+	
+	auto startTime = steady_clock::now();
+	std::vector<Position> positions = loadDataset(dataset, maxPositions);
+	if (positions.empty()) {
+		std::cout << "No positions loaded from " << dataset << std::endl;
+		return 1;
+	}
+	auto loadTime = duration_cast<milliseconds>(steady_clock::now() - startTime).count();
+	std::cout << "Loaded " << positions.size() << " positions in " << loadTime << " ms" << std::endl;
+	
+	Tuner tuner(positions, threads);
+	if (k <= 0.0) {
+		k = tuner.fitScale();
+		std::cout << "Fitted scale K = " << k << std::endl;
+	}
+	
+	std::vector<Parameter> parameters = collectParameters();
+	double bestError = tuner.error(k);
+	std::cout << parameters.size() << " parameters, initial error " << std::setprecision(8) << bestError << std::endl;
+	
+	// Local search: Move every parameter by one step as long as the error decreases
+	for (int iteration = 1; iteration <= iterations; ++iteration) {
+		auto iterationStart = steady_clock::now();
+		u64 evaluationsBefore = tuner.evaluations();
+		int improved = 0;
+		
+		for (const Parameter& parameter : parameters) {
+			int value = *parameter.value;
+			for (int delta : { STEP, -STEP }) {
+				setParameter(parameter, value + delta);
+				double e = tuner.error(k);
+				if (e < bestError) {
+					bestError = e;
+					++improved;
+					break;
+				}
+				setParameter(parameter, value);
+			}
+		}
+		
+		double seconds = duration<double>(steady_clock::now() - iterationStart).count();
+		u64 evaluated = tuner.evaluations() - evaluationsBefore;
+		std::cout << "Iteration " << iteration << ": error " << bestError << ", " << improved << " changed, ";
+		std::cout << (u64) (evaluated / std::max(seconds, 0.001)) << " positions/s on " << threads << " threads" << std::endl;
+		
+		writeTables(output);
+		if (improved == 0) break;
+	}
+	
+	std::cout << "Tables written to " << output << std::endl;
+	return 0;
+}
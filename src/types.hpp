@@ -1,9 +1,7 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
-#include <boost/tokenizer.hpp>
-
-typedef boost::tokenizer<boost::char_separator<char>> tokenizer;
 
 typedef uint8_t u8;
 typedef uint16_t u16;
@@ -1,39 +1,133 @@
-#include "boost/tokenizer.hpp"
+#include <algorithm>
+#include <cstdlib>
 
+#include "batch.hpp"
+#include "bitbases.hpp"
+#include "bench.hpp"
+#include "datagen.hpp"
 #include "engine.hpp"
-#include "evaluator.hpp"
+#include "match.hpp"
+#include "profiler.hpp"
+#include "tbcheck.hpp"
+#include "testsuite.hpp"
+#include "tokens.hpp"
 #include "types.hpp"
 #include "uci.hpp"
 
+// Size at which the output buffer is written without a sync point
+#define OUTPUT_BUFFER_SIZE 65536
+
+// Longest time a buffered message waits for the next one before it is written
+#define OUTPUT_DELAY_MS 100
+
 using std::string;
+using std::string_view;
+
+void OutputWriter::write(string_view message)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto now = std::chrono::steady_clock::now();
+	if (buffer_.empty()) pendingSince_ = now;
+	buffer_.append(message);
+	buffer_.push_back('\n');
+	
+	// The GUI waits for these answers before it sends the next command
+	bool sync = (message.compare(0, 8, "bestmove") == 0 || message == "readyok" || message == "uciok");
+	if (sync || buffer_.size() >= OUTPUT_BUFFER_SIZE || now - pendingSince_ >= std::chrono::milliseconds(OUTPUT_DELAY_MS)) {
+		writeBuffer();
+	}
+}
+
+void OutputWriter::flush()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	writeBuffer();
+}
 
-const std::vector<string> c_ValidCommands = {
-	"uci", "isready", "ucinewgame", "position", "go", "stop", "debug", "quit",
-	"move", "board", "moves", "eval"
-};
+void OutputWriter::writeBuffer()
+{
+	if (buffer_.empty()) return;
+	out_.write(buffer_.data(), buffer_.size());
+	out_.flush();
+	buffer_.clear();
+}
 
 UCIProtocol::UCIProtocol(std::unique_ptr<Engine> engine):engine_(std::move(engine))
 {
 }
 
-void UCIProtocol::recvMessage(const string& message)
+// Dispatches on the length first, so that a name is compared with at most a few commands
+UCIProtocol::Command UCIProtocol::findCommand(string_view name)
+{
+	switch (name.size()) {
+	case 2:
+		if (name == "go") return go;
+		break;
+	case 3:
+		if (name == "uci") return uci;
+		if (name == "epd") return epd;
+		break;
+	case 4:
+		if (name == "stop") return stop;
+		if (name == "quit") return quit;
+		if (name == "move") return move;
+		if (name == "eval") return eval;
+		break;
+	case 5:
+		switch (name[0]) {
+		case 'd': if (name == "debug") return debug; break;
+		case 'b':
+			if (name == "board") return board;
+			if (name == "bench") return bench;
+			if (name == "batch") return batch;
+			break;
+		case 'm':
+			if (name == "moves") return moves;
+			if (name == "match") return match;
+			break;
+		case 's': if (name == "stats") return stats; break;
+		}
+		break;
+	case 7:
+		if (name == "isready") return isready;
+		if (name == "gensfen") return gensfen;
+		if (name == "profile") return profile;
+		if (name == "tbcheck") return tbcheck;
+		break;
+	case 8:
+		if (name == "position") return position;
+		if (name == "bitbases") return bitbases;
+		break;
+	case 9:
+		if (name == "ponderhit") return ponderhit;
+		if (name == "setoption") return setoption;
+		break;
+	case 10:
+		if (name == "ucinewgame") return ucinewgame;
+		break;
+	}
+	return none;
+}
+
+void UCIProtocol::recvMessage(string_view message)
 {
 	//std::cout << "<< " << message << std::endl;
 	
-	// Split into tokens
-	boost::char_separator<char> separator(" \t");
-	tokenizer tokens(message, separator);
-	auto token = tokens.begin();
-	
 	// Find first recognized command
-	string command;
+	Tokens tokens(message);
+	Command command;
 	do {
-		if (token == tokens.end()) return;
-		command = *token;
-		++token;
-	} while (std::find(c_ValidCommands.begin(), c_ValidCommands.end(), command) == c_ValidCommands.end());
+		if (tokens.empty()) return;
+		command = findCommand(tokens.next());
+	} while (command == none);
 	
-	if (command == "uci")
+	// Commands that change the engine state have to wait for a running search
+	if (command != isready && command != stop && command != quit && command != debug && command != ponderhit) {
+		engine_->Wait();
+	}
+	
+	switch (command) {
+	case uci:
 	{
 		// Identify engine and options
 		sendMessage("id name " + engine_->name());
@@ -42,54 +136,154 @@ void UCIProtocol::recvMessage(const string& message)
 			sendMessage("option " + option);
 		}
 		sendMessage("uciok");
+		break;
 	}
-	else if (command == "isready")
+	case isready:
 	{
 		// Wait until the engine is ready for a new command
 		sendMessage("readyok");
+		break;
 	}
-	else if (command == "ucinewgame")
+	case ucinewgame:
 	{
 		// Start a new game
+		engine_->newGame();
+		position_.clear();
+		break;
 	}
-	else if (command == "position")
+	case position:
 	{
-		// Enter a position
-		if (!engine_->board().setPosition(tokens, token)) {
-			engine_->board().setInitialPosition();
+		// Enter a position. GUIs send all moves of the game with every position
+		// command, so if it extends the previous one, only the new moves are played.
+		ChessBoard& board = engine_->board();
+		string_view text = tokens.rest();
+		while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) text.remove_suffix(1);
+		bool valid;
+		if (extendsPosition(text)) {
+			Tokens moves(text.substr(position_.size()));
+			if (position_.find(" moves") == string::npos && moves.next() != "moves") {
+				valid = board.setPosition(text);
+			} else {
+				valid = board.playMoves(moves.rest());
+			}
+		} else {
+			valid = board.setPosition(text);
+		}
+		if (!valid) {
+			board.setInitialPosition();
 			sendMessage("info string error: invalid position");
+			position_.clear();
+			break;
 		}
+		position_ = text;
+		positionZobrist_ = board.zobrist_;
+		positionPlies_ = board.history_.size();
+		break;
 	}
-	else if (command == "go")
+	case go:
 	{
 		// Start thinking
-		engine_->Search();
+		SearchLimits limits;
+		int* values[] = {
+			&limits.wtime, &limits.btime, &limits.winc, &limits.binc,
+			&limits.movestogo, &limits.movetime, &limits.depth, &limits.mate
+		};
+		static const string_view names[] = {
+			"wtime", "btime", "winc", "binc", "movestogo", "movetime", "depth", "mate"
+		};
+		while (!tokens.empty()) {
+			string_view name = tokens.next();
+			auto it = std::find(std::begin(names), std::end(names), name);
+			if (name == "infinite") {
+				limits.infinite = true;
+			} else if (name == "ponder") {
+				limits.ponder = true;
+			} else if (tokens.empty()) {
+				break;
+			} else if (name == "nodes") {
+				limits.nodes = Tokens::toU64(tokens.next());
+			} else if (it != std::end(names)) {
+				*values[it - std::begin(names)] = Tokens::toInt(tokens.next());
+				if (it - std::begin(names) < 4) limits.clock = true;
+			}
+		}
+		// Without any limit the search runs until "stop"
+		if (!limits.clock && !limits.movetime && !limits.depth && !limits.nodes && !limits.mate)
+		{
+			limits.infinite = true;
+		}
+		engine_->Go(limits);
+		break;
+	}
+	case ponderhit:
+	{
+		// The expected move was played: Switch from pondering to searching
+		engine_->PonderHit();
+		break;
+	}
+	case setoption:
+	{
+		// Change an option: setoption name <id> [value <x>]
+		// Names and values may contain spaces
+		string name, value;
+		string* target = nullptr;
+		while (!tokens.empty()) {
+			string_view token = tokens.next();
+			if (token == "name") {
+				target = &name;
+			} else if (token == "value") {
+				target = &value;
+			} else if (target) {
+				if (!target->empty()) *target += " ";
+				target->append(token);
+			}
+		}
+		if (!engine_->setOption(name, value)) {
+			sendMessage("info string error: invalid option " + name);
+		} else {
+			// Remember the option for engines created later (e.g. for benchmarks)
+			auto option = std::find_if(options_.begin(), options_.end(),
+				[&](const std::pair<string, string>& o) { return o.first == name; });
+			if (option != options_.end()) {
+				option->second = value;
+			} else {
+				options_.emplace_back(name, value);
+			}
+		}
+		break;
 	}
-	else if (command == "stop")
+	case stop:
 	{
 		// Stop thinking
+		engine_->Stop();
+		break;
 	}
-	else if (command == "debug")
+	case debug:
 	{
 		// Enable/Disable debug mode
-		bool debug_value = (token != tokens.end() && *token == "on");
+		bool debug_value = (tokens.next() == "on");
 		engine_->setDebug(debug_value);
+		break;
 	}
-	else if (command == "quit")
+	case quit:
 	{
 		// Quit the engine
+		engine_->Stop();
+		engine_->Wait();
 		running_ = false;
+		break;
 	}
-	else if (command == "move")
+	case move:
 	{
 		// Execute a move
-		if (token != tokens.end()) {
-			move_t move = engine_->board().parseMove(*token);
+		if (!tokens.empty()) {
+			move_t move = engine_->board().parseMove(string(tokens.next()));
 			engine_->board().printMove(std::cout, move);
 			engine_->board().doMove(move);
 		}
+		break;
 	}
-	else if (command == "moves")
+	case moves:
 	{
 		std::vector<move_t> movelist;
 		engine_->board().generateMoves(movelist);
@@ -97,34 +291,261 @@ void UCIProtocol::recvMessage(const string& message)
 		for (move_t move : movelist) {
 			engine_->board().printMove(std::cout, move);
 		}
+		break;
 	}
-	else if (command == "board")
+	case board:
 	{
 		// Print the board state
 		engine_->board().printBoard(std::cout);
+		break;
+	}
+	case eval:
+	{
+		score_t score = engine_->evaluate();
+		std::cout << "Score: " << score << " [in 1/100ths of a pawn, ";
+		std::cout << (engine_->usesNNUE() ? "NNUE" : "classical") << "]" << std::endl;
+		break;
+	}
+	case bench:
+	{
+		// Fixed depth benchmark: bench [depth] [hash] [threads] [json]
+		// Protocol benchmark: bench protocol [lines] [json]
+		// Parser benchmark: bench fen [<file>] [json]
+		Tokens peek = tokens;
+		string_view mode = peek.next();
+		if (mode == "fen") {
+			string file;
+			bool json = false;
+			while (!peek.empty()) {
+				string_view token = peek.next();
+				if (token == "json") json = true;
+				else file = string(token);
+			}
+			Benchmark::runFEN(file, json);
+			break;
+		}
+		if (mode == "protocol") {
+			tokens = peek;
+			u64 lines = 0;
+			bool json = false;
+			while (!tokens.empty()) {
+				string_view token = tokens.next();
+				if (token == "json") json = true;
+				else lines = Tokens::toU64(token);
+			}
+			Benchmark::runProtocol(lines, json);
+			break;
+		}
+		Benchmark::Settings settings;
+		settings.options = options_;
+		int* values[] = { &settings.depth, &settings.hashSize, &settings.threads };
+		for (int i = 0; !tokens.empty();) {
+			string_view token = tokens.next();
+			if (token == "json") {
+				settings.json = true;
+			} else if (i < 3) {
+				*values[i++] = std::max(1, Tokens::toInt(token));
+			}
+		}
+		Benchmark::run(settings);
+		break;
+	}
+	case gensfen:
+	{
+		// Self-play training data: gensfen [games <n>] [depth <d>] [nodes <n>] [threads <t>]
+		// [hash <mb>] [random <plies>] [seed <s>] [output <file>] [compress]
+		DataGenerator::Settings settings;
+		settings.options = options_;
+		while (!tokens.empty()) {
+			string_view key = tokens.next();
+			if (key == "compress") {
+				settings.compress = true;
+				continue;
+			}
+			if (tokens.empty()) break;
+			string_view value = tokens.next();
+			if (key == "games") settings.games = Tokens::toU64(value);
+			else if (key == "depth") settings.depth = std::max(1, Tokens::toInt(value));
+			else if (key == "nodes") settings.nodes = Tokens::toU64(value);
+			else if (key == "threads") settings.threads = std::max(1, Tokens::toInt(value));
+			else if (key == "hash") settings.hashSize = std::max(1, Tokens::toInt(value));
+			else if (key == "random") settings.randomPlies = std::max(0, Tokens::toInt(value));
+			else if (key == "seed") settings.seed = Tokens::toU64(value);
+			else if (key == "output") settings.output = string(value);
+		}
+		DataGenerator::run(settings);
+		break;
+	}
+	case match:
+	{
+		// Self-play match: match [games <n>] [depth <d>] [nodes <n>] [movetime <ms>] [threads <t>]
+		// [hash <mb>] [openings <epd>] [random <plies>] [seed <s>] [elo0 <x>] [elo1 <x>]
+		// [alpha <x>] [beta <x>] [first <name>=<value>] [second <name>=<value>]
+		// Options set before apply to both configurations
+		Match::Settings settings;
+		settings.options[0] = settings.options[1] = options_;
+		while (!tokens.empty()) {
+			string_view key = tokens.next();
+			if (tokens.empty()) break;
+			string_view value = tokens.next();
+			if (key == "games") settings.games = Tokens::toU64(value);
+			else if (key == "depth") settings.depth = std::max(1, Tokens::toInt(value));
+			else if (key == "nodes") settings.nodes = Tokens::toU64(value);
+			else if (key == "movetime") settings.movetime = std::max(1, Tokens::toInt(value));
+			else if (key == "threads") settings.threads = std::max(1, Tokens::toInt(value));
+			else if (key == "hash") settings.hashSize = std::max(1, Tokens::toInt(value));
+			else if (key == "openings") settings.openings = string(value);
+			else if (key == "random") settings.randomPlies = std::max(0, Tokens::toInt(value));
+			else if (key == "seed") settings.seed = Tokens::toU64(value);
+			else if (key == "elo0") settings.elo0 = Tokens::toDouble(value);
+			else if (key == "elo1") settings.elo1 = Tokens::toDouble(value);
+			else if (key == "alpha") settings.alpha = Tokens::toDouble(value);
+			else if (key == "beta") settings.beta = Tokens::toDouble(value);
+			else if (key == "first" || key == "second") {
+				size_t separator = value.find('=');
+				if (separator == string_view::npos) continue;
+				settings.options[key == "first" ? 0 : 1].emplace_back(value.substr(0, separator), value.substr(separator + 1));
+			}
+		}
+		Match::run(settings);
+		break;
+	}
+	case epd:
+	{
+		// Test suite: epd <file> [depth <d>] [nodes <n>] [movetime <ms>] [threads <t>] [hash <mb>] [json]
+		TestSuite::Settings settings;
+		settings.options = options_;
+		if (!tokens.empty()) settings.file = string(tokens.next());
+		while (!tokens.empty()) {
+			string_view key = tokens.next();
+			if (key == "json") {
+				settings.json = true;
+				continue;
+			}
+			if (tokens.empty()) break;
+			string_view value = tokens.next();
+			if (key == "depth") settings.depth = std::max(1, Tokens::toInt(value));
+			else if (key == "nodes") settings.nodes = Tokens::toU64(value);
+			else if (key == "movetime") settings.movetime = std::max(1, Tokens::toInt(value));
+			else if (key == "threads") settings.threads = std::max(1, Tokens::toInt(value));
+			else if (key == "hash") settings.hashSize = std::max(1, Tokens::toInt(value));
+		}
+		TestSuite::run(settings);
+		break;
+	}
+	case batch:
+	{
+		// Batch analysis of the jobs on the remaining input: batch [threads <t>] [hash <mb>]
+		BatchAnalysis::Settings settings;
+		settings.options = options_;
+		while (!tokens.empty()) {
+			string_view key = tokens.next();
+			if (tokens.empty()) break;
+			string_view value = tokens.next();
+			if (key == "threads") settings.threads = std::max(1, Tokens::toInt(value));
+			else if (key == "hash") settings.hashSize = std::max(1, Tokens::toInt(value));
+		}
+		BatchAnalysis::run(settings, std::cin);
+		break;
+	}
+	case bitbases:
+	{
+		// Endgame bitbases: bitbases [threads <t>] [output <directory>] [endgames <KQK,KRK,KBNK,KPK>]
+		Bitbases::Settings settings;
+		while (!tokens.empty()) {
+			string_view key = tokens.next();
+			if (tokens.empty()) break;
+			string_view value = tokens.next();
+			if (key == "threads") settings.threads = std::max(1, Tokens::toInt(value));
+			else if (key == "output") settings.output = string(value);
+			else if (key == "endgames") settings.endgames = string(value);
+		}
+		Bitbases::run(settings);
+		break;
+	}
+	case tbcheck:
+	{
+		// Tablebase check: tbcheck syzygy <path> [bitbases <directory>] [positions <n>] [seed <s>]
+		TablebaseCheck::Settings settings;
+		while (!tokens.empty()) {
+			string_view key = tokens.next();
+			if (tokens.empty()) break;
+			string_view value = tokens.next();
+			if (key == "syzygy") settings.syzygyPath = string(value);
+			else if (key == "bitbases") settings.bitbasePath = string(value);
+			else if (key == "positions") settings.positions = Tokens::toU64(value);
+			else if (key == "seed") settings.seed = Tokens::toU64(value);
+		}
+		TablebaseCheck::run(settings);
+		break;
 	}
-	else if (command == "eval")
+	case profile:
 	{
-		Evaluator eval;
-		score_t score = eval.evaluatePosition(engine_->board());
-		std::cout << "Score: " << score << " [in 1/1000ths of a pawn]" << std::endl;
+		// Cycles of the profiled sections in all searches so far: profile [reset]
+		if (!Profiler::enabled()) {
+			sendMessage("info string profiler not compiled in (build with -DENABLE_PROFILER)");
+		} else if (tokens.next() == "reset") {
+			Profiler::reset();
+		} else {
+			for (const string& line : Profiler::report()) sendMessage("info string " + line);
+		}
+		break;
 	}
+	case stats:
+	{
+		// Statistics of the last search
+		for (const string& line : engine_->stats().report()) sendMessage("info string " + line);
+		string line = "info string iteration nodes";
+		for (const Engine::Iteration& iteration : engine_->iterations()) {
+			line += " " + std::to_string(iteration.depth) + ":" + std::to_string(iteration.nodes);
+		}
+		sendMessage(line);
+		break;
+	}
+	case none:
+		break;
+	}
+}
+
+// The board has to be unchanged since the last position command, which is
+// followed by more moves in the new one
+bool UCIProtocol::extendsPosition(string_view position) const
+{
+	const ChessBoard& board = engine_->board();
+	return !position_.empty() && board.zobrist_ == positionZobrist_ && board.history_.size() == positionPlies_ &&
+		position.size() > position_.size() && position.compare(0, position_.size(), position_) == 0 &&
+		(position[position_.size()] == ' ' || position[position_.size()] == '\t');
+}
+
+// Messages are sent from the search thread and the input thread
+static OutputWriter& output()
+{
+	static OutputWriter writer(std::cout);
+	return writer;
 }
 
-void UCIProtocol::sendMessage(const string& message)
+void UCIProtocol::sendMessage(string_view message)
 {
-	std::cout << message << std::endl;
+	output().write(message);
+}
+
+void UCIProtocol::flush()
+{
+	output().flush();
 }
 
 void UCIProtocol::run()
 {
 	running_ = true;
 	while (running_) {
+		// Answers to a command are complete when the next one is read
+		flush();
 		string message;
 		if (getline(std::cin, message, '\n')) {
 			recvMessage(message);
 		} else {
-			running_ = false;
+			recvMessage("quit");
 		}
 	}
-}
\ No newline at end of file
+	flush();
+}
@@ -1,22 +1,68 @@
 #pragma once
 
+#include <chrono>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "types.hpp"
 
 // Forward declarations
 class Engine;
 
+// Collects protocol messages and writes them in blocks. The buffer is flushed
+// at the sync points of the protocol (bestmove, readyok, uciok), when it is
+// full, when its oldest message is waiting for too long and on flush().
+class OutputWriter
+{
+public:
+	explicit OutputWriter(std::ostream& out):out_(out) {}
+	
+	// Appends a line
+	void write(std::string_view message);
+	void flush();
+
+private:
+	void writeBuffer();
+	
+	std::mutex mutex_;
+	std::ostream& out_;
+	std::string buffer_;
+	std::chrono::steady_clock::time_point pendingSince_;
+
+};
+
 class UCIProtocol
 {
 public:
+	enum Command {
+		none, uci, isready, ucinewgame, position, go, stop, debug, quit, move, board, moves,
+		eval, bench, ponderhit, setoption, gensfen, match, epd, batch, bitbases, stats, profile, tbcheck
+	};
+	
 	UCIProtocol(std::unique_ptr<Engine> engine);
 	void run();
+	void recvMessage(std::string_view message);
 	
-	static void sendMessage(const std::string& message);
+	// The command of a token, none if it is not recognized
+	static Command findCommand(std::string_view name);
 	
+	// Messages are buffered, see OutputWriter
+	static void sendMessage(std::string_view message);
+	static void flush();
+
 private:
-	void recvMessage(const std::string& message);
+	bool extendsPosition(std::string_view position) const;
 	
 	bool running_;
 	std::unique_ptr<Engine> engine_;
+	std::vector<std::pair<std::string, std::string>> options_;
+	
+	// Last position command and the board it left
+	std::string position_;
+	u64 positionZobrist_ = 0;
+	size_t positionPlies_ = 0;
 };
\ No newline at end of file